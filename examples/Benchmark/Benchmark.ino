@@ -0,0 +1,83 @@
+// Runs the request, parse and event paths against fixtures and prints one JSON
+// line of stats per response size. Build with SS_PROFILE set to 1 in common.h.
+// The device must have authorized once so there is a refresh token to refresh;
+// fixture runs never overwrite it.
+#include <SimpliSafe3.h>
+#include <Profiler.h>
+
+#define ITERATIONS 50
+
+#define LOG(message, ...) printf(">>> [%7d][%.2fkb] Benchmark.ino: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), ##__VA_ARGS__)
+
+SimpliSafe3 ss;
+const size_t sizes[] = { 512, 2048, 8192 };
+
+// pad a body out to roughly targetBytes with fields the filters throw away
+String pad(const char *prefix, const char *suffix, size_t targetBytes) {
+    String out = prefix;
+    out += "\"padding\":[";
+    int x = 0;
+    while (out.length() + strlen(suffix) + 32 < targetBytes) {
+        if (x > 0) out += ",";
+        out += "{\"id\":" + String(x++) + ",\"name\":\"filler\"}";
+    }
+    out += "],";
+    out += suffix;
+    return out;
+}
+
+void runSize(size_t bytes) {
+    String subscriptions = pad(
+        "{\"subscriptions\":[{",
+        "\"sid\":1234,\"location\":{\"system\":{\"alarmState\":\"HOME\",\"isAlarming\":false}}}]}",
+        bytes
+    );
+    String lock = pad("[{", "\"serial\":\"abc123\",\"status\":{\"lockState\":1,\"lockJamState\":0}}]", bytes);
+    String token = pad("{", "\"access_token\":\"a\",\"refresh_token\":\"r\",\"token_type\":\"Bearer\",\"expires_in\":3600}", bytes);
+    String event = pad(
+        "{\"type\":\"com.simplisafe.event.standard\",\"data\":{",
+        "\"eventCid\":1400,\"messageSubject\":\"Benchmark\"}}",
+        bytes
+    );
+
+    const SS3Fixture fixtures[] = {
+        { false, "/api/authCheck", 200, "{\"userId\":5678}" },
+        { false, "/subscriptions?", 200, subscriptions.c_str() },
+        { false, "/doorlock/", 200, lock.c_str() },
+        { true, "/doorlock/", 200, "{}" },
+        { true, "/oauth/token", 200, token.c_str() }
+    };
+    ss.setFixtures(fixtures, sizeof(fixtures) / sizeof(fixtures[0]));
+    SS3Profiler::reset();
+
+    uint8_t *frame = (uint8_t *)malloc(event.length() + 1);
+    for (int x = 0; x < ITERATIONS; x++) {
+        ss.getAlarmState();
+        ss.getLockState();
+        ss.setLockState(SS_SETLOCKSTATE_LOCK);
+        ss.refreshAuthorization(); // token refresh through the fixture
+
+        memcpy(frame, event.c_str(), event.length() + 1); // parsed in place, so copy each time
+        ss.handleFrame(frame, event.length());
+    }
+    free(frame);
+
+    ss.setFixtures(nullptr, 0);
+    SS3Profiler::printJson(Serial, String(bytes).c_str());
+}
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial) { ; }; // wait for serial
+    LOG("Starting...");
+
+    #if !SS_PROFILE
+        LOG("SS_PROFILE is off, stats will be empty.");
+    #endif
+
+    ss.setup();
+    for (size_t x = 0; x < sizeof(sizes) / sizeof(sizes[0]); x++) runSize(sizes[x]);
+    LOG("Done.");
+}
+
+void loop() {}
@@ -0,0 +1,72 @@
+// First boot: captures a few minutes of real API and WebSocket traffic to SPIFFS.
+// Later boots: replays the capture as fast as possible and prints throughput.
+// Tokens are redacted before anything is written.
+#include <WiFi.h>
+#include <SPIFFS.h>
+#include "secrets.h"
+#include <SimpliSafe3.h>
+#include <Trace.h>
+
+#define TRACE_FILE "/ss_trace.bin"
+#define CAPTURE_MS 300000 // 5 minutes
+#define POLL_MS 30000
+
+#define LOG(message, ...) printf(">>> [%7d][%.2fkb] Replay.ino: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), ##__VA_ARGS__)
+
+SimpliSafe3 ss;
+bool capturing = false;
+unsigned long lastPoll = 0;
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial) { ; }; // wait for serial
+    LOG("Starting...");
+
+    SPIFFS.begin(true);
+    if (SPIFFS.exists(TRACE_FILE)) {
+        SS3TraceReplayer replayer;
+        SS3ReplayStats stats = replayer.run(ss, TRACE_FILE);
+        LOG(
+            "Replayed %lu ops, %lu responses and %lu frames in %lums, worst frame %luus.",
+            stats.ops,
+            stats.responses,
+            stats.frames,
+            stats.elapsedMS,
+            stats.maxFrameUS
+        );
+        return;
+    }
+
+    WiFi.begin(WIFI_SSID, WIFI_PASS);
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(500);
+    }
+    LOG("Connected to %s.", WIFI_SSID);
+
+    capturing = SS3Trace::begin(TRACE_FILE);
+    if (ss.setup()) {
+        ss.startListeningToEvents(
+            [](int eventId) { LOG("Captured a %i event.", eventId); },
+            nullptr,
+            nullptr
+        );
+    }
+}
+
+void loop() {
+    if (!capturing) return;
+
+    ss.loop();
+
+    if (millis() - lastPoll >= POLL_MS) {
+        ss.getAlarmState();
+        ss.getLockState();
+        lastPoll = millis();
+    }
+
+    if (millis() >= CAPTURE_MS) {
+        SS3Trace::end();
+        capturing = false;
+        LOG("Capture done, reboot to replay.");
+    }
+}
@@ -0,0 +1,110 @@
+// Pushes events, commands, token refreshes and reconnect handshakes through the
+// library against fixtures until SOAK_EVENTS events have been handled, printing
+// one JSON line of heap health every SAMPLE_EVERY cycles. Stops with FAIL as
+// soon as the largest free block, live allocations or minimum free heap drift.
+// Like Benchmark, the device must have authorized once so setup() has a token.
+#include <SimpliSafe3.h>
+#include <HeapMonitor.h>
+
+#define SOAK_EVENTS 1000000UL
+#define EVENTS_PER_CYCLE 8
+#define WARMUP_CYCLES 200    // pools, caches and the sensor table settle before the baseline
+#define SAMPLE_EVERY 500     // cycles between heap samples
+#define REFRESH_EVERY 20     // cycles between token refreshes
+#define RECONNECT_EVERY 50   // cycles between simulated hello/subscribed handshakes, identify is built but not sent
+#define SENSORS_EVERY 250    // cycles between sensor inventory refreshes
+
+#define LOG(message, ...) printf(">>> [%7d][%.2fkb] Soak.ino: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), ##__VA_ARGS__)
+
+SimpliSafe3 ss;
+SS3HeapMonitor monitor;
+unsigned long cycle = 0;
+unsigned long events = 0;
+bool done = false;
+
+const int cids[] = { 1400, 3441, 3401, 1134, 1429, 9700, 9701, 1170 };
+const char *frames[] = {
+    "{\"type\":\"com.simplisafe.service.hello\"}",
+    "{\"type\":\"com.simplisafe.service.registered\"}",
+    "{\"type\":\"com.simplisafe.namespace.subscribed\"}"
+};
+
+const SS3Fixture fixtures[] = {
+    { false, "/api/authCheck", 200, "{\"userId\":5678}" },
+    { false, "/sensors?", 200, "{\"sensors\":[{\"serial\":\"a1\",\"type\":5,\"name\":\"Front Door\",\"status\":{\"triggered\":false}},"
+        "{\"serial\":\"a2\",\"type\":4,\"name\":\"Hall Motion\",\"status\":{\"triggered\":false}}]}" },
+    { false, "/subscriptions?", 200, "{\"subscriptions\":[{\"sid\":1234,\"location\":{\"system\":{\"alarmState\":\"HOME\",\"isAlarming\":false}}}]}" },
+    { false, "/doorlock/", 200, "[{\"serial\":\"abc123\",\"status\":{\"lockState\":1,\"lockJamState\":0}}]" },
+    { true, "/doorlock/", 200, "{}" },
+    { true, "/state/", 200, "{\"state\":\"AWAY\"}" },
+    { true, "/oauth/token", 200, "{\"access_token\":\"a\",\"refresh_token\":\"r\",\"token_type\":\"Bearer\",\"expires_in\":3600}" }
+};
+
+// handleFrame parses in place, so every frame gets a fresh copy
+void sendFrame(const char *frame) {
+    char buffer[320];
+    strlcpy(buffer, frame, sizeof(buffer));
+    ss.handleFrame((uint8_t *)buffer, strlen(buffer));
+}
+
+void runCycle() {
+    char frame[320];
+    for (int x = 0; x < EVENTS_PER_CYCLE; x++) {
+        snprintf(
+            frame,
+            sizeof(frame),
+            "{\"type\":\"com.simplisafe.event.standard\",\"data\":{\"eventCid\":%i,\"sid\":1234,\"sensorSerial\":\"a%i\","
+            "\"sensorType\":5,\"sensorName\":\"Front Door\",\"eventTimestamp\":%lu,\"messageSubject\":\"Soak\"}}",
+            cids[(events + x) % (sizeof(cids) / sizeof(cids[0]))],
+            (int)(x % 2) + 1,
+            1700000000UL + events
+        );
+        sendFrame(frame);
+    }
+    events += EVENTS_PER_CYCLE;
+
+    ss.getAlarmState();
+    ss.getLockState();
+    ss.setLockState(cycle % 2 ? SS_SETLOCKSTATE_LOCK : SS_SETLOCKSTATE_UNLOCK);
+    if (cycle % 3 == 0) ss.setAlarmState(SS_SETSTATE_AWAY);
+
+    if (cycle % REFRESH_EVERY == 0) ss.refreshAuthorization();
+    if (cycle % SENSORS_EVERY == 0) ss.refreshSensors();
+    if (cycle % RECONNECT_EVERY == 0) {
+        for (size_t x = 0; x < sizeof(frames) / sizeof(frames[0]); x++) sendFrame(frames[x]);
+    }
+
+    ss.loop();
+    cycle++;
+}
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial) { ; }; // wait for serial
+    LOG("Starting...");
+
+    ss.setup();
+    ss.setFixtures(fixtures, sizeof(fixtures) / sizeof(fixtures[0]));
+    ss.refreshSensors();
+}
+
+void loop() {
+    if (done) return;
+
+    runCycle();
+
+    if (cycle == WARMUP_CYCLES) monitor.setBaseline();
+    if (cycle < WARMUP_CYCLES || cycle % SAMPLE_EVERY != 0) return;
+
+    monitor.sample();
+    monitor.printJson(Serial, "soak");
+    if (!monitor.check()) {
+        LOG("FAIL: heap drifted after %lu events and %lu cycles.", events, cycle);
+        done = true;
+    } else if (events >= SOAK_EVENTS) {
+        LOG("PASS: %lu events and %lu cycles without heap drift.", events, cycle);
+        done = true;
+    }
+
+    if (done) ss.setFixtures(nullptr, 0);
+}
@@ -0,0 +1,190 @@
+// Pushes hostile and high-rate WebSocket frames through the frame handler and
+// prints one JSON line per phase with frames per second and worst-case latency.
+// Frames go straight to handleFrame(), so no WiFi or account is needed. Phases:
+// valid events at full rate, every truncation of an event, frames over
+// SS_FRAME_MAX_LENGTH, nesting past SS_FRAME_NESTING_LIMIT, frames that parse
+// but aren't events, and random bytes. Ends with PASS when every hostile frame
+// was rejected, no valid one was, and the heap came back.
+#include <SimpliSafe3.h>
+#include <FrameParser.h>
+
+#define RATE_FRAMES 20000   // valid events in the throughput phase
+#define RANDOM_FRAMES 5000  // frames of random bytes
+#define RANDOM_MAX 512      // longest random frame
+#define DEEP_LEVELS 64      // nesting depth of the deep frames, well past the limit
+
+#define LOG(message, ...) printf(">>> [%7d][%.2fkb] Stress.ino: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), ##__VA_ARGS__)
+
+SimpliSafe3 ss;
+uint8_t *buffer = nullptr; // handleFrame parses in place, so every frame is copied here first
+bool passed = true;
+
+const char *event =
+    "{\"type\":\"com.simplisafe.event.standard\",\"data\":{\"eventCid\":1400,\"sid\":1234,\"sensorSerial\":\"a1\","
+    "\"sensorType\":5,\"sensorName\":\"Front Door\",\"eventTimestamp\":1700000000,\"messageSubject\":\"Stress\"}}";
+
+// parse but aren't events a listener should see
+const char *wrongShapes[] = {
+    "{}",
+    "[]",
+    "null",
+    "42",
+    "\"com.simplisafe.event.standard\"",
+    "{\"type\":5}",
+    "{\"type\":null}",
+    "{\"type\":\"com.simplisafe.event.standard\"}",
+    "{\"type\":\"com.simplisafe.event.standard\",\"data\":\"x\"}",
+    "{\"type\":\"com.simplisafe.event.standard\",\"data\":[1,2,3]}",
+    "{\"type\":\"com.simplisafe.event.standard\",\"data\":null}"
+};
+
+struct Phase {
+    const char *name;
+    unsigned long frames;
+    unsigned long totalUS;
+    unsigned long worstUS;
+    unsigned long rejected;
+
+    Phase(const char *phaseName) : name(phaseName), frames(0), totalUS(0), worstUS(0), rejected(0) {}
+};
+
+unsigned long rejectedCount() {
+    const SS3FrameStats &stats = SS3FrameParser::getStats();
+    return stats.oversized + stats.tooDeep + stats.noMemory + stats.malformed;
+}
+
+void send(Phase &phase, const uint8_t *frame, size_t length) {
+    memcpy(buffer, frame, length);
+    buffer[length] = 0;
+
+    unsigned long rejected = rejectedCount();
+    unsigned long start = micros();
+    ss.handleFrame(buffer, length);
+    unsigned long elapsed = micros() - start;
+
+    phase.frames++;
+    phase.totalUS += elapsed;
+    phase.worstUS = max(phase.worstUS, elapsed);
+    phase.rejected += rejectedCount() - rejected;
+}
+
+void finish(Phase &phase, unsigned long expectRejected) {
+    float seconds = phase.totalUS / 1000000.0f;
+    Serial.printf(
+        "{\"phase\":\"%s\",\"frames\":%lu,\"rejected\":%lu,\"framesPerSecond\":%.0f,\"averageUS\":%lu,\"worstUS\":%lu}\n",
+        phase.name,
+        phase.frames,
+        phase.rejected,
+        seconds > 0 ? phase.frames / seconds : 0.0f,
+        phase.frames > 0 ? phase.totalUS / phase.frames : 0,
+        phase.worstUS
+    );
+
+    if (phase.rejected != expectRejected) {
+        LOG("FAIL: %s rejected %lu of %lu frames, expected %lu.", phase.name, phase.rejected, phase.frames, expectRejected);
+        passed = false;
+    }
+}
+
+void runRate() {
+    Phase phase("rate");
+    for (unsigned long x = 0; x < RATE_FRAMES; x++) send(phase, (const uint8_t *)event, strlen(event));
+    finish(phase, 0);
+}
+
+void runTruncated() {
+    // every prefix of an event is invalid JSON
+    Phase phase("truncated");
+    size_t length = strlen(event);
+    for (size_t x = 0; x < length; x++) send(phase, (const uint8_t *)event, x);
+    finish(phase, length);
+}
+
+void runOversized() {
+    // a valid event padded past the limit, rejected before it's parsed
+    Phase phase("oversized");
+    size_t length = SS_FRAME_MAX_LENGTH + 1;
+    uint8_t *frame = (uint8_t *)malloc(length);
+    memset(frame, ' ', length);
+    memcpy(frame, event, strlen(event));
+    for (int x = 0; x < 100; x++) send(phase, frame, length);
+    free(frame);
+    finish(phase, 100);
+}
+
+void runDeep() {
+    // nested at the top level and inside a field the filter throws away
+    Phase phase("deep");
+    String top, field = "{\"type\":\"com.simplisafe.event.standard\",\"data\":{\"eventCid\":1400,\"extra\":";
+    for (int x = 0; x < DEEP_LEVELS; x++) top += "[";
+    for (int x = 0; x < DEEP_LEVELS; x++) top += "]";
+    for (int x = 0; x < DEEP_LEVELS; x++) field += "{\"a\":";
+    field += "1";
+    for (int x = 0; x < DEEP_LEVELS; x++) field += "}";
+    field += "}}";
+
+    for (int x = 0; x < 100; x++) {
+        send(phase, (const uint8_t *)top.c_str(), top.length());
+        send(phase, (const uint8_t *)field.c_str(), field.length());
+    }
+    finish(phase, 200);
+}
+
+void runWrongShape() {
+    Phase phase("wrongShape");
+    size_t count = sizeof(wrongShapes) / sizeof(wrongShapes[0]);
+    for (int x = 0; x < 100; x++) {
+        for (size_t y = 0; y < count; y++) send(phase, (const uint8_t *)wrongShapes[y], strlen(wrongShapes[y]));
+    }
+    finish(phase, 100 * count);
+}
+
+void runRandom() {
+    // even random bytes that happen to be JSON won't be an object with a string type
+    Phase phase("random");
+    uint8_t frame[RANDOM_MAX];
+    for (int x = 0; x < RANDOM_FRAMES; x++) {
+        size_t length = 1 + esp_random() % RANDOM_MAX;
+        esp_fill_random(frame, length);
+        send(phase, frame, length);
+    }
+    finish(phase, RANDOM_FRAMES);
+}
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial) { ; }; // wait for serial
+    LOG("Starting...");
+
+    buffer = (uint8_t *)malloc(SS_FRAME_MAX_LENGTH + 2);
+
+    runRate(); // first, so the pools and caches are warm before the heap is measured
+    size_t freeBefore = esp_get_free_heap_size();
+
+    runTruncated();
+    runOversized();
+    runDeep();
+    runWrongShape();
+    runRandom();
+    runRate();
+
+    size_t freeAfter = esp_get_free_heap_size();
+    if (freeAfter + 1024 < freeBefore) {
+        LOG("FAIL: free heap went from %u to %u bytes.", freeBefore, freeAfter);
+        passed = false;
+    }
+
+    const SS3FrameStats &stats = SS3FrameParser::getStats();
+    LOG(
+        "%s: %lu frames, %lu oversized, %lu too deep, %lu out of memory, %lu malformed.",
+        passed ? "PASS" : "FAIL",
+        stats.frames,
+        stats.oversized,
+        stats.tooDeep,
+        stats.noMemory,
+        stats.malformed
+    );
+}
+
+void loop() {
+}
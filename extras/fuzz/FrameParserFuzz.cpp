@@ -0,0 +1,37 @@
+// libFuzzer harness for SS3FrameParser, which sees every WebSocket frame before
+// a listener does. FrameParser builds without the Arduino core, so this runs on
+// a host against ArduinoJson 6:
+//
+//   clang++ -std=c++11 -g -O1 -fsanitize=fuzzer,address,undefined
+//       -I../../src -I<path to ArduinoJson>/src
+//       FrameParserFuzz.cpp ../../src/FrameParser.cpp -o FrameParserFuzz
+//   ./FrameParserFuzz -max_len=9000 corpus
+//
+// A crash, sanitizer report or broken invariant below is a bug in the parser.
+#include <stdlib.h>
+#include <string.h>
+#include "FrameParser.h"
+
+#define FUZZ_DOC_SIZE 2048 // SS_PARSE_FRAME_SIZE, the pooled frame document
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // parsed in place, and WebSocketsClient terminates the payload it hands over
+    uint8_t *payload = (uint8_t *)malloc(size + 1);
+    if (!payload) return 0;
+    memcpy(payload, data, size);
+    payload[size] = 0;
+
+    DynamicJsonDocument doc(FUZZ_DOC_SIZE);
+    const char *reason = nullptr;
+    unsigned long frames = SS3FrameParser::getStats().frames;
+    int frame = SS3FrameParser::parse(payload, size, doc, &reason);
+
+    if (SS3FrameParser::getStats().frames != frames + 1) abort();
+    if (frame == SS_FRAME_INVALID && !reason) abort();
+    if (frame != SS_FRAME_INVALID && !doc["type"].is<const char *>()) abort();
+    if (frame == SS_FRAME_EVENT && !doc["data"].is<JsonObject>()) abort();
+    if (size > SS_FRAME_MAX_LENGTH && frame != SS_FRAME_INVALID) abort();
+
+    free(payload);
+    return 0;
+}
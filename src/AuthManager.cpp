@@ -1,5 +1,11 @@
 #include "AuthManager.h"
 #include "common.h"
+#include "ChunkedStream.h"
+#include "ConnectionPool.h"
+#include "Lock.h"
+#include "Memory.h"
+#include "Profiler.h"
+#include "Trace.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
@@ -9,6 +15,13 @@
 #include <SPIFFS.h>
 #include <time.h>
 
+const SS3Header SS_TOKEN_HEADERS[4] = {
+    { "Host", "auth.simplisafe.com" },
+    { "Content-Type", "application/json" },
+    { "Content-Length", "186" },
+    { "Auth0-Client", SS_OAUTH_AUTH0_CLIENT }
+};
+
 class AllowAllFilter : ArduinoJson6191_F1::Filter {
     bool allow() const {
         return true;
@@ -56,54 +69,65 @@ void SS3AuthManager::sha256(const char *inBuff, uint8_t *outBuff) {
     hash.finalize(outBuff, SHA256_LEN);
 }
 
-String SS3AuthManager::getSS3AuthURL() {
+bool SS3AuthManager::getSS3AuthURL(char *buffer, size_t size) {
     SS_LOG_LINE("Getting authorization URL.");
     SS_DETAIL_LINE("Code Verifier:  %s", codeVerifier.c_str());
     SS_DETAIL_LINE("Code Challenge: %s", codeChallenge.c_str());    
-    String ecnodedRedirect = String(SS_OAUTH_REDIRECT_URI);
-    ecnodedRedirect.replace(":", "%3A");
-    ecnodedRedirect.replace("/", "%2F");
-    return String(SS_OAUTH_AUTH_URL) +
-        "?client_id=" + SS_OAUTH_CLIENT_ID +
-        "&scope=" + SS_OAUTH_SCOPE +
-        "&response_type=code" +
-        "&redirect_uri=" + ecnodedRedirect +
-        "&code_challenge_method=S256" +
-        "&code_challenge=" + codeChallenge +
-        "&audience=" + SS_OAUTH_AUDIENCE +
-        "&auth0Client=" + SS_OAUTH_AUTH0_CLIENT
-    ;
+    int length = snprintf(
+        buffer,
+        size,
+        "%s?client_id=%s&scope=%s&response_type=code&redirect_uri=%s"
+        "&code_challenge_method=S256&code_challenge=%s&audience=%s&auth0Client=%s",
+        SS_OAUTH_AUTH_URL,
+        SS_OAUTH_CLIENT_ID,
+        SS_OAUTH_SCOPE,
+        SS_OAUTH_REDIRECT_URI_ENCODED,
+        codeChallenge.c_str(),
+        SS_OAUTH_AUDIENCE,
+        SS_OAUTH_AUTH0_CLIENT
+    );
+
+    if (length < 0 || length >= (int)size) {
+        SS_ERROR_LINE("Authorization URL doesn't fit in %u bytes.", size);
+        return false;
+    }
+
+    return true;
+}
+
+void SS3AuthManager::setAuthorization() {
+    authorization = "";
+    if (accessToken.length() == 0) return;
+
+    authorization.reserve(tokenType.length() + 1 + accessToken.length());
+    authorization += tokenType;
+    authorization += ' ';
+    authorization += accessToken;
 }
 
 bool SS3AuthManager::getAuthToken(String code) {
     SS_LOG_LINE("Getting authorization tokens.");
-    StaticJsonDocument<256> headers;
-    headers[0]["name"] = "Host";
-    headers[0]["value"] = "auth.simplisafe.com";
-    headers[1]["name"] = "Content-Type";
-    headers[1]["value"] = "application/json";
-    headers[2]["name"] = "Content-Length";
-    headers[2]["value"] = "186";
-    headers[3]["name"] = "Auth0-Client";
-    headers[3]["value"] = SS_OAUTH_AUTH0_CLIENT;
-
     StaticJsonDocument<256> payloadDoc;
-    String payload;
+    char payload[SS_TOKEN_PAYLOAD_MAX];
     payloadDoc["grant_type"] = "authorization_code";
     payloadDoc["client_id"] = SS_OAUTH_CLIENT_ID;
-    payloadDoc["code_verifier"] = codeVerifier;
+    payloadDoc["code_verifier"] = codeVerifier.c_str();
     code.replace("\n", "");
     code.replace("\r", "");
-    payloadDoc["code"] = code;
+    payloadDoc["code"] = code.c_str();
     payloadDoc["redirect_uri"] = SS_OAUTH_REDIRECT_URI;
-    serializeJson(payloadDoc, payload);
-    
-    DynamicJsonDocument resDoc(3072);
-    int res = request(SS_OAUTH + String("/token"), resDoc, false, true, payload, headers);
+    if (measureJson(payloadDoc) >= sizeof(payload)) {
+        SS_ERROR_LINE("Token request doesn't fit in %u bytes.", sizeof(payload));
+        return false;
+    }
+    serializeJson(payloadDoc, payload, sizeof(payload));
+
+    SS3PooledDocument resDoc(SS_PARSE_SLOT_TOKEN);
+    int res = request(SS_OAUTH "/token", resDoc.get(), false, true, payload, SS_TOKEN_HEADERS, sizeof(SS_TOKEN_HEADERS) / sizeof(SS_TOKEN_HEADERS[0]));
 
     if (res >= 200 && res <= 299) {
         SS_LOG_LINE("Got authorization tokens.");
-        return storeAuthToken(resDoc);
+        return storeAuthToken(resDoc.get());
     }
 
     SS_ERROR_LINE("Error getting authorization tokens.");
@@ -112,42 +136,38 @@ bool SS3AuthManager::getAuthToken(String code) {
 
 bool SS3AuthManager::refreshAuthToken() {
     SS_LOG_LINE("Getting refresh token.");
-    StaticJsonDocument<256> headers;
-    headers[0]["name"] = "Host";
-    headers[0]["value"] = "auth.simplisafe.com";
-    headers[1]["name"] = "Content-Type";
-    headers[1]["value"] = "application/json";
-    headers[2]["name"] = "Content-Length";
-    headers[2]["value"] = "186";
-    headers[3]["name"] = "Auth0-Client";
-    headers[3]["value"] = SS_OAUTH_AUTH0_CLIENT;
-
+    SS_PROFILE_SCOPE(SS_PROFILE_REFRESH_TOKEN);
     StaticJsonDocument<256> payloadDoc;
-    String payload;
+    char payload[SS_TOKEN_PAYLOAD_MAX];
     payloadDoc["grant_type"] = "refresh_token";
     payloadDoc["client_id"] = SS_OAUTH_CLIENT_ID;
-    payloadDoc["refresh_token"] = refreshToken;
-    serializeJson(payloadDoc, payload);
+    payloadDoc["refresh_token"] = refreshToken.c_str();
+    if (measureJson(payloadDoc) >= sizeof(payload)) {
+        SS_ERROR_LINE("Token request doesn't fit in %u bytes.", sizeof(payload));
+        return false;
+    }
+    serializeJson(payloadDoc, payload, sizeof(payload));
 
-    DynamicJsonDocument resDoc(3072);
-    int res = request(SS_OAUTH + String("/token"), resDoc, false, true, payload, headers);
+    SS3PooledDocument resDoc(SS_PARSE_SLOT_TOKEN);
+    int res = request(SS_OAUTH "/token", resDoc.get(), false, true, payload, SS_TOKEN_HEADERS, sizeof(SS_TOKEN_HEADERS) / sizeof(SS_TOKEN_HEADERS[0]));
 
     if (res >= 200 && res <= 299) {
         SS_LOG_LINE("Got refresh token.");
-        return storeAuthToken(resDoc);
+        return storeAuthToken(resDoc.get());
     }
     
     SS_ERROR_LINE("Error getting refresh token.");
     return false;
 }
 
-bool SS3AuthManager::storeAuthToken(const DynamicJsonDocument &doc) {
+bool SS3AuthManager::storeAuthToken(const JsonDocument &doc) {
     SS_LOG_LINE("Storing authorization tokens.");
     accessToken = doc["access_token"].as<String>();
     refreshToken = doc["refresh_token"].as<String>();
     tokenType = doc["token_type"].as<String>();
     tokenIssueMS = millis();
     expiresInMS = doc["expires_in"].as<unsigned long>() * 1000;
+    tokenExpiresAt = time(nullptr) >= SS_MIN_VALID_TIME ? time(nullptr) + expiresInMS / 1000 : 0;
 
     if (
         !accessToken.equals("null") &&
@@ -156,12 +176,15 @@ bool SS3AuthManager::storeAuthToken(const DynamicJsonDocument &doc) {
         expiresInMS != 0
     ) {
         SS_LOG_LINE("Stored authorization tokens.");
+        setAuthorization();
+        if (fixtureCount > 0) return true; // never overwrite real credentials with fixture tokens
         return writeUserData();
     }
 
     accessToken = ""; // reset so that string length is 0
     refreshToken = "";
     tokenType = "Bearer";
+    setAuthorization();
     SS_ERROR_LINE("Error storing authorization tokens.");
     return false;
 }
@@ -174,24 +197,24 @@ bool SS3AuthManager::writeUserData() {
     userData["accessToken"] = accessToken;
     userData["refreshToken"] = refreshToken;
     userData["codeVerifier"] = codeVerifier;
+    userData["expiresAt"] = (long long)tokenExpiresAt;
 
+    // left mounted, the event journal and traces use it too
     if (SPIFFS.begin(true)) {
-        File file = SPIFFS.open(SS_USER_DATA_FILE, "w");
+        File file = SPIFFS.open(userDataPath, "w");
         if (file) {
             if (serializeJson(userData, file) > 0) {
                 SS_LOG_LINE("Wrote authorization tokens to file.");
             } else {
-                SS_ERROR_LINE("Failed to write data to %s.", SS_USER_DATA_FILE);
+                SS_ERROR_LINE("Failed to write data to %s.", userDataPath.c_str());
                 success = false;
             }
 
             file.close();
         } else {
-            SS_ERROR_LINE("Failed to open %s.", SS_USER_DATA_FILE);
+            SS_ERROR_LINE("Failed to open %s.", userDataPath.c_str());
             success = false;
         }
-
-        SPIFFS.end();
     } else {
         SS_ERROR_LINE("Error starting SPIFFS.");
         success = false;
@@ -205,18 +228,19 @@ bool SS3AuthManager::readUserData() {
     bool success = true;
 
     if (SPIFFS.begin(true)) {
-        File file = SPIFFS.open(SS_USER_DATA_FILE, "r");
+        File file = SPIFFS.open(userDataPath, "r");
         if (file) {
             DynamicJsonDocument userData(1536);
             DeserializationError err = deserializeJson(userData, file);
             if (err) {
-                SS_ERROR_LINE("Error deserializing %s.", SS_USER_DATA_FILE);
+                SS_ERROR_LINE("Error deserializing %s.", userDataPath.c_str());
                 SS_ERROR_LINE("%s", err.c_str());
                 success = false;
             } else {
                 accessToken = userData["accessToken"].as<String>();
                 refreshToken = userData["refreshToken"].as<String>();
                 codeVerifier = userData["codeVerifier"].as<String>();
+                tokenExpiresAt = userData["expiresAt"] | 0LL;
 
                 if (
                     accessToken.equals("null") ||
@@ -229,6 +253,7 @@ bool SS3AuthManager::readUserData() {
                     codeVerifier = "";
                     success = false;
                 }
+                setAuthorization();
 
                 SS_LOG_LINE("Read authorization tokens from file.");
                 #if SS_DEBUG >= SS_DEBUG_LEVEL_ALL
@@ -239,11 +264,9 @@ bool SS3AuthManager::readUserData() {
 
             file.close();
         } else {
-            SS_ERROR_LINE("Failed to open %s.", SS_USER_DATA_FILE);
+            SS_ERROR_LINE("Failed to open %s.", userDataPath.c_str());
             success = false;
         }
-
-        SPIFFS.end();
     } else {
         SS_ERROR_LINE("Error starting SPIFFS.");
         success = false;
@@ -252,12 +275,160 @@ bool SS3AuthManager::readUserData() {
     return success;
 }
 
+bool SS3AuthManager::hasHeapFor(int endpoint) {
+    // a new connection costs a handshake, a pooled one only the response
+    bool open = SS3ConnectionPool::isConnected(endpoint);
+    size_t cost = open ? SS_HEAP_REQUEST_COST : SS_HEAP_TLS_COST;
+    size_t block = open ? SS_HEAP_REQUEST_COST : SS_HEAP_TLS_BLOCK;
+    if (SS3Memory::allows(cost, block, "request")) return true;
+
+    SS3ConnectionPool::closeIdle(endpoint);
+    return SS3Memory::allows(cost, block, "request");
+}
+
+int SS3AuthManager::getEndpoint(const char *url) {
+    if (strncmp(url, "https://auth", 12) == 0) return SS_ENDPOINT_AUTH;
+    if (strncmp(url, "https://api", 11) == 0) return SS_ENDPOINT_API;
+    return SS_ENDPOINT_OTHER;
+}
+
+DeserializationError SS3AuthManager::parse(
+    Stream &stream,
+    size_t size,
+    JsonDocument &doc,
+    const JsonDocument *filter,
+    const DeserializationOption::NestingLimit &nestingLimit
+) {
+    DeserializationError err;
+    SS_PROFILE_PARSE_BEGIN();
+    if (filter && filter->size() != 0) err = deserializeJson(doc, stream, DeserializationOption::Filter(*filter), nestingLimit);
+    else err = deserializeJson(doc, stream, nestingLimit);
+    SS_PROFILE_PARSE_END(size, doc.memoryUsage());
+
+    if (err) {
+        SS_ERROR_LINE("API request deserialization error: %s", err.c_str());
+    } else {
+        SS_DETAIL_LINE("Desearialized stream to json.");
+        #if SS_DEBUG >= SS_DEBUG_LEVEL_ALL
+            serializeJsonPretty(doc, Serial);
+            Serial.println("");
+        #endif
+    }
+
+    return err;
+}
+
+int SS3AuthManager::httpsRequest(
+    const char *url,
+    JsonDocument &doc,
+    bool auth,
+    bool post,
+    const char *payload,
+    const SS3Header *headers,
+    size_t headerCount,
+    const JsonDocument *filter,
+    const DeserializationOption::NestingLimit &nestingLimit,
+    unsigned long &retryAfterMS
+) {
+    int res = -1;
+    HTTPClient https;
+    const char *collect[] = { "Retry-After" };
+    SS3PooledClient pooled(getEndpoint(url));
+    WiFiClientSecure &client = pooled.get();
+    https.setReuse(pooled.isKeptAlive());
+    https.useHTTP10(!pooled.isKeptAlive()); // keep-alive needs HTTP/1.1, which may send chunked bodies
+
+    if (https.begin(client, url)){
+        if (auth) {
+            SS_DETAIL_LINE("Setting authorization credentials.");
+            https.setAuthorization(""); // clear it out
+            https.addHeader("Authorization", authorization);
+        }
+
+        for (size_t x = 0; x < headerCount; x++) {
+            https.addHeader(headers[x].name, headers[x].value);
+            SS_DETAIL_LINE("Added header: \"%s: %s\"", headers[x].name, headers[x].value);
+        }
+
+        if (SS3Trace::isRecording()) SS3Trace::recordRequest(url, post, payload);
+        https.collectHeaders(collect, 1);
+        if (post) res = https.POST((uint8_t *)payload, strlen(payload));
+        else res = https.GET();
+        SS_DETAIL_LINE("Request sent. Response: %i", res);
+
+        if (https.hasHeader("Retry-After")) {
+            // only the delay-seconds form, an HTTP-date falls back to backoff
+            retryAfterMS = https.header("Retry-After").toInt() * 1000UL;
+            SS_DETAIL_LINE("Retry-After: %lums", retryAfterMS);
+        }
+
+        if (SS3Trace::isRecording()) {
+            // buffer the body so the trace gets a copy, costs a String only while capturing
+            String body = https.getString();
+            SS3Trace::recordResponse(res, body);
+            if (res >= 200 && res <= 299) {
+                SS3BufferStream stream((const uint8_t *)body.c_str(), body.length());
+                parse(stream, body.length(), doc, filter, nestingLimit);
+            } else {
+                SS_ERROR_LINE("Error, code: %i.", res);
+                SS_ERROR_LINE("Response: %s", body.c_str());
+            }
+        } else if (res >= 200 && res <= 299 && https.getSize() < 0 && pooled.isKeptAlive()) {
+            // chunked, strip the framing as the body streams through the filter
+            SS3ChunkedStream body(client);
+            DeserializationError err = parse(body, 0, doc, filter, nestingLimit);
+            if (!body.drain() || err) pooled.discard();
+        } else if (res >= 200 && res <= 299) {
+            if (parse(client, max(https.getSize(), 0), doc, filter, nestingLimit)) pooled.discard();
+            while (client.available() > 0) client.read(); // trailing whitespace would corrupt the next response
+        } else {
+            SS_ERROR_LINE("Error, code: %i.", res);
+            SS_ERROR_LINE("Response: %s", https.getString().c_str());
+        }
+
+        if (res < 0) pooled.discard();
+        https.end();
+    } else {
+        SS_ERROR_LINE("Could not connect to %s.", url);
+        pooled.discard();
+    }
+
+    return res;
+}
+
+int SS3AuthManager::fixtureRequest(
+    const char *url,
+    JsonDocument &doc,
+    bool post,
+    const JsonDocument *filter,
+    const DeserializationOption::NestingLimit &nestingLimit
+) {
+    for (size_t x = 0; x < fixtureCount; x++) {
+        const SS3Fixture &fixture = fixtures[x];
+        if (fixture.post != post || !strstr(url, fixture.path)) continue;
+
+        SS_DETAIL_LINE("Serving fixture %u. Response: %i", x, fixture.status);
+        if (fixture.status >= 200 && fixture.status <= 299) {
+            size_t size = strlen(fixture.body);
+            SS3BufferStream stream((const uint8_t *)fixture.body, size);
+            parse(stream, size, doc, filter, nestingLimit);
+        }
+
+        return fixture.status;
+    }
+
+    SS_ERROR_LINE("No fixture for %s.", url);
+    return 404;
+}
+
 //
 // Public Member Functions
 //
 
-SS3AuthManager::SS3AuthManager() {
+SS3AuthManager::SS3AuthManager(const char *account) {
     SS_LOG_LINE("Making Authorization Manager.");
+    lock = xSemaphoreCreateRecursiveMutex();
+    userDataPath = account && account[0] ? String(SS_USER_DATA_PREFIX) + account + ".json" : String(SS_USER_DATA_FILE);
     if(!readUserData()) {
         SS_LOG_LINE("No previous authorization tokens, generating codes.");
         uint8_t randData[32]; // 32 bytes, u_int8_t is 1 byte
@@ -272,11 +443,14 @@ SS3AuthManager::SS3AuthManager() {
 
 bool SS3AuthManager::authorize(bool forceReauth, HardwareSerial *hwSerial, unsigned long baud) {
     SS_LOG_LINE("Authorizing.");
+    SS3Lock authGuard(lock);
     if (refreshToken.length() == 0 || forceReauth) {
         if (!hwSerial) hwSerial->begin(baud);
         while (!hwSerial) { ; }
+        char authURL[SS_AUTH_URL_MAX];
+        if (!getSS3AuthURL(authURL, sizeof(authURL))) return false;
         hwSerial->println("Get that damn URL code:");
-        hwSerial->println(getSS3AuthURL().c_str());
+        hwSerial->println(authURL);
         while (hwSerial->available() > 0) { hwSerial->read(); } // flush serial monitor
         while (hwSerial->available() == 0) { delay(100); } // wait for url input
         String code = hwSerial->readString();
@@ -293,8 +467,37 @@ bool SS3AuthManager::authorize(bool forceReauth, HardwareSerial *hwSerial, unsig
     return refreshAuthToken();
 }
 
+bool SS3AuthManager::authorizeIfNeeded(HardwareSerial *hwSerial, unsigned long baud) {
+    // checked again under the lock, another instance on this account may have just refreshed
+    SS3Lock authGuard(lock);
+    if (isAuthorized()) return true;
+    return authorize(false, hwSerial, baud);
+}
+
+bool SS3AuthManager::restoreAuthToken() {
+    SS_LOG_LINE("Checking persisted authorization token.");
+    SS3Lock authGuard(lock);
+    time_t now = time(nullptr);
+    if (accessToken.length() == 0 || tokenExpiresAt == 0 || now < SS_MIN_VALID_TIME) {
+        SS_LOG_LINE("Can't reuse persisted token.");
+        return false;
+    }
+
+    long long remainingMS = (long long)(tokenExpiresAt - now) * 1000;
+    if (remainingMS <= SS_AUTH_REFRESH_BUFFER) {
+        SS_LOG_LINE("Persisted token expires too soon to reuse.");
+        return false;
+    }
+
+    tokenIssueMS = millis();
+    expiresInMS = remainingMS;
+    SS_LOG_LINE("Reusing persisted token, %llds left.", remainingMS / 1000);
+    return true;
+}
+
 bool SS3AuthManager::isAuthorized() {
     SS_LOG_LINE("Checking if authorized...");
+    SS3Lock authGuard(lock);
     if (tokenIssueMS == -1 || expiresInMS == -1) return false;
 
     unsigned long now = millis();
@@ -305,78 +508,109 @@ bool SS3AuthManager::isAuthorized() {
 }
 
 int SS3AuthManager::request(
-    String url, 
+    const char *url, 
     JsonDocument &doc, 
     bool auth, 
     bool post, 
-    String payload, 
-    const DynamicJsonDocument &headers, 
-    const DynamicJsonDocument &filter,
+    const char *payload, 
+    const SS3Header *headers, 
+    size_t headerCount,
+    const JsonDocument *filter,
     const DeserializationOption::NestingLimit &nestingLimit
 ) {
     SS_LOG_LINE("Making a request.");
-    SS_DETAIL_LINE("Requesting: %s %s", post ? "POST" : "GET", url.c_str());
+    SS_DETAIL_LINE("Requesting: %s %s", post ? "POST" : "GET", url);
     SS_DETAIL_LINE("Authorized: %s", auth ? "yes" : "no");
-    SS_DETAIL_LINE("Payload: %s", payload.c_str());
+    SS_DETAIL_LINE("Payload: %s", payload);
 
+    if (url[0] == '\0') {
+        SS_ERROR_LINE("No URL to request.");
+        return -1;
+    }
+
+    SS3Lock authGuard(lock);
     int res = -1;
+    int endpoint = getEndpoint(url);
+    SS3CircuitBreaker &breaker = breakers[endpoint];
+
+    if (fixtureCount > 0 || WiFi.status() == WL_CONNECTED) {
+        // an open circuit fails fast, before closing anyone's idle connections for heap
+        if (!breaker.allowRequest()) {
+            SS_ERROR_LINE("Circuit open for endpoint %i, not requesting.", endpoint);
+            return SS_REQUEST_CIRCUIT_OPEN;
+        }
 
-    if (WiFi.status() == WL_CONNECTED) {
-        HTTPClient https;
-        WiFiClientSecure client;
-        https.useHTTP10(true); // for ArduinoJson
+        if (fixtureCount == 0 && !hasHeapFor(endpoint)) {
+            breaker.cancelRequest();
+            return SS_REQUEST_DEFERRED;
+        }
 
-        if (url.indexOf("https://auth") >= 0) client.setCACert(SS_OAUTH_CA_CERT);
-        else if (url.indexOf("https://api") >= 0) client.setCACert(SS_API_CERT);
-        else client.setInsecure();
+        unsigned long retryAfterMS = 0;
+        if (fixtureCount > 0) res = fixtureRequest(url, doc, post, filter, nestingLimit);
+        else res = httpsRequest(url, doc, auth, post, payload, headers, headerCount, filter, nestingLimit, retryAfterMS);
 
-        if (https.begin(client, url)){
-            if (auth) {
-                SS_DETAIL_LINE("Setting authorization credentials.");
-                https.setAuthorization(""); // clear it out
-                https.addHeader("Authorization", tokenType + " " + accessToken);
-            }
+        breaker.recordResult(res, retryAfterMS);
+    } else SS_ERROR_LINE("Not connected to WiFi.");
 
-            if (headers.size() != 0) {
-                SS_DETAIL_LINE("Detected headers.");
-                for (int x = 0; x < headers.size(); x++) {
-                    SS_DETAIL_LINE("Adding header %i.", x);
-                    https.addHeader(headers[x]["name"], headers[x]["value"]);
-                    SS_DETAIL_LINE(
-                        "Added header: \"%s: %s\"", 
-                        headers[x]["name"].as<const char*>(), 
-                        headers[x]["value"].as<const char*>()
-                    );
-                }
-            }
+    if (res == 401 && auth && endpoint == SS_ENDPOINT_API && !retryingAuth) {
+        // revoked or expired early, so the token can't be trusted until it's refreshed
+        SS_ERROR_LINE("Access token rejected, refreshing.");
+        accessToken = "";
+        tokenIssueMS = -1;
+        tokenExpiresAt = 0;
+        setAuthorization();
+
+        retryingAuth = true;
+        if (refreshAuthToken()) res = request(url, doc, auth, post, payload, headers, headerCount, filter, nestingLimit);
+        retryingAuth = false;
+    }
 
-            if (post) res = https.POST(payload);
-            else res = https.GET();
-            SS_DETAIL_LINE("Request sent. Response: %i", res);
+    return res;
+}
 
-            if (res >= 200 && res <= 299) {
-                DeserializationError err;
-                if (filter.size() != 0) err = deserializeJson(doc, client, DeserializationOption::Filter(filter), nestingLimit);
-                else err = deserializeJson(doc, client, nestingLimit);
-                
-                if (err) {
-                    SS_ERROR_LINE("API request deserialization error: %s", err.c_str());
-                } else {
-                    SS_DETAIL_LINE("Desearialized stream to json.");
-                    #if SS_DEBUG >= SS_DEBUG_LEVEL_ALL
-                        serializeJsonPretty(doc, Serial);
-                        Serial.println("");
-                    #endif
-                }
-            } else {
-                SS_ERROR_LINE("Error, code: %i.", res);
-                SS_ERROR_LINE("Response: %s", https.getString().c_str());
-            }
+String SS3AuthManager::getAccessToken() {
+    SS3Lock authGuard(lock);
+    return accessToken;
+}
 
-            client.stop();
-            https.end();
-        } else SS_ERROR_LINE("Could not connect to %s.", url.c_str());
-    } else SS_ERROR_LINE("Not connected to WiFi.");
+void SS3AuthManager::setFixtures(const SS3Fixture *fixtureList, size_t count) {
+    SS_LOG_LINE("Serving %u fixtures instead of the network.", count);
+    SS3Lock authGuard(lock);
+    size_t newCount = fixtureList ? count : 0;
+
+    // fixture token responses replace the tokens in memory, keep the real ones for afterwards
+    if (fixtureCount == 0 && newCount > 0) {
+        realTokens.accessToken = accessToken;
+        realTokens.refreshToken = refreshToken;
+        realTokens.tokenType = tokenType;
+        realTokens.tokenIssueMS = tokenIssueMS;
+        realTokens.expiresInMS = expiresInMS;
+        realTokens.tokenExpiresAt = tokenExpiresAt;
+    } else if (fixtureCount > 0 && newCount == 0) {
+        SS_LOG_LINE("Restoring authorization tokens from before fixtures.");
+        accessToken = realTokens.accessToken;
+        refreshToken = realTokens.refreshToken;
+        tokenType = realTokens.tokenType;
+        tokenIssueMS = realTokens.tokenIssueMS;
+        expiresInMS = realTokens.expiresInMS;
+        tokenExpiresAt = realTokens.tokenExpiresAt;
+        setAuthorization();
+        realTokens = SS3SavedTokens();
+    }
 
-    return res;
+    fixtures = fixtureList;
+    fixtureCount = newCount;
+}
+
+bool SS3AuthManager::hasFixtures() {
+    SS3Lock authGuard(lock);
+    return fixtureCount > 0;
+}
+
+int SS3AuthManager::getBreakerState(int endpoint) {
+    return breakers[endpoint].getState();
+}
+
+const SS3BreakerMetrics &SS3AuthManager::getBreakerMetrics(int endpoint) {
+    return breakers[endpoint].getMetrics();
 }
@@ -2,43 +2,101 @@
 #define __SS3AUTHMANAGER_H__
 
 #include <ArduinoJson.h>
+#include "CircuitBreaker.h"
+#include "Fixture.h"
+#include "Request.h"
 
 #define SHA256_LEN 32
 
+struct SS3SavedTokens {
+    String accessToken;
+    String refreshToken;
+    String tokenType;
+    unsigned long tokenIssueMS;
+    unsigned long expiresInMS;
+    time_t tokenExpiresAt;
+};
+
 class SS3AuthManager {
     private:
+        String userDataPath;
+        SemaphoreHandle_t lock;
         String refreshToken;
         String codeVerifier;
         String codeChallenge;
+        String authorization; // "<tokenType> <accessToken>", rebuilt only when the token changes
         unsigned long tokenIssueMS = -1;
         unsigned long expiresInMS = -1;
+        time_t tokenExpiresAt = 0; // wall clock, persisted so a reboot can reuse the token
+        SS3CircuitBreaker breakers[SS_ENDPOINT_COUNT];
+        const SS3Fixture *fixtures = nullptr;
+        size_t fixtureCount = 0;
+        bool retryingAuth = false; // one refresh and retry per rejected token
+        SS3SavedTokens realTokens;  // put back when fixtures are cleared
 
         String base64URLEncode(uint8_t *buffer);
         void sha256(const char *inBuff, uint8_t *outBuff);
-        String getSS3AuthURL();
+        bool getSS3AuthURL(char *buffer, size_t size);
+        void setAuthorization();
         bool getAuthToken(String code);
         bool refreshAuthToken();
-        bool storeAuthToken(const DynamicJsonDocument &doc);
+        bool storeAuthToken(const JsonDocument &doc);
+        bool hasHeapFor(int endpoint);
         bool writeUserData();
         bool readUserData();
+        int getEndpoint(const char *url);
+        DeserializationError parse(
+            Stream &stream,
+            size_t size,
+            JsonDocument &doc,
+            const JsonDocument *filter,
+            const DeserializationOption::NestingLimit &nestingLimit
+        );
+        int httpsRequest(
+            const char *url,
+            JsonDocument &doc,
+            bool auth,
+            bool post,
+            const char *payload,
+            const SS3Header *headers,
+            size_t headerCount,
+            const JsonDocument *filter,
+            const DeserializationOption::NestingLimit &nestingLimit,
+            unsigned long &retryAfterMS
+        );
+        int fixtureRequest(
+            const char *url,
+            JsonDocument &doc,
+            bool post,
+            const JsonDocument *filter,
+            const DeserializationOption::NestingLimit &nestingLimit
+        );
 
     public:
         String tokenType = "Bearer";
         String accessToken;
 
-        SS3AuthManager();
+        SS3AuthManager(const char *account = "");
         bool authorize(bool forceReauth, HardwareSerial *hwSerial, unsigned long baud);
+        bool authorizeIfNeeded(HardwareSerial *hwSerial, unsigned long baud);
         bool isAuthorized();
+        bool hasFixtures();
+        String getAccessToken();
+        bool restoreAuthToken();
         int request(
-            String url, 
+            const char *url, 
             JsonDocument &doc, 
             bool auth = true, 
             bool post = false, 
-            String payload = "", 
-            const DynamicJsonDocument &headers = StaticJsonDocument<0>(), 
-            const DynamicJsonDocument &filter = StaticJsonDocument<0>(),
+            const char *payload = "", 
+            const SS3Header *headers = nullptr, 
+            size_t headerCount = 0,
+            const JsonDocument *filter = nullptr,
             const DeserializationOption::NestingLimit &nestingLimit = DeserializationOption::NestingLimit()
         );
+        void setFixtures(const SS3Fixture *fixtureList, size_t count);
+        int getBreakerState(int endpoint);
+        const SS3BreakerMetrics &getBreakerMetrics(int endpoint);
 };
 
 #endif
\ No newline at end of file
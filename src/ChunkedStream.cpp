@@ -0,0 +1,107 @@
+#include "ChunkedStream.h"
+#include "common.h"
+
+//
+// Private Member Functions
+//
+
+int SS3ChunkedStream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = source.read();
+        if (c >= 0) return c;
+        delay(1);
+    } while (millis() - start < source.getTimeout());
+
+    SS_ERROR_LINE("Timed out reading chunked body.");
+    failed = true;
+    return -1;
+}
+
+bool SS3ChunkedStream::skipLine() {
+    int c;
+    while ((c = timedRead()) >= 0 && c != '\n') {}
+    return c == '\n';
+}
+
+bool SS3ChunkedStream::nextChunk() {
+    if (done || failed) return false;
+    if (started && !skipLine()) return false; // CRLF after the previous chunk's data
+
+    // hex size, then optional ;extensions up to CRLF
+    size_t size = 0;
+    int digits = 0;
+    int c;
+    while ((c = timedRead()) >= 0 && isxdigit(c)) {
+        size = size * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+        digits++;
+    }
+    if (c < 0) return false;
+    if (digits == 0 || (c != '\n' && !skipLine())) {
+        SS_ERROR_LINE("Bad chunk size in response.");
+        failed = true;
+        return false;
+    }
+
+    if (size == 0) {
+        // trailers, if any, end with an empty line
+        for (;;) {
+            int first = timedRead();
+            if (first < 0) return false;
+            if (first == '\r') first = timedRead();
+            if (first == '\n') break;
+            if (!skipLine()) return false;
+        }
+        done = true;
+        return false;
+    }
+
+    remaining = size;
+    started = true;
+    return true;
+}
+
+//
+// Public Member Functions
+//
+
+SS3ChunkedStream::SS3ChunkedStream(Stream &source) : source(source) {
+    setTimeout(0); // read() does its own waiting, Stream's timed reads mustn't wait again on the end
+}
+
+int SS3ChunkedStream::available() {
+    if (done || failed) return 0;
+    int waiting = source.available();
+    return remaining > 0 ? min((int)remaining, waiting) : waiting > 0;
+}
+
+int SS3ChunkedStream::read() {
+    if (remaining == 0 && !nextChunk()) return -1;
+
+    int c = timedRead();
+    if (c >= 0) remaining--;
+    return c;
+}
+
+int SS3ChunkedStream::peek() {
+    if (remaining == 0 && !nextChunk()) return -1;
+    return source.peek();
+}
+
+size_t SS3ChunkedStream::readBytes(char *out, size_t count) {
+    size_t n = 0;
+    int c;
+    while (n < count && (c = read()) >= 0) out[n++] = c;
+    return n;
+}
+
+size_t SS3ChunkedStream::write(uint8_t) {
+    return 0; // read only
+}
+
+void SS3ChunkedStream::flush() {}
+
+bool SS3ChunkedStream::drain() {
+    while (read() >= 0) {}
+    return done;
+}
@@ -0,0 +1,33 @@
+#ifndef __SS3CHUNKEDSTREAM_H__
+#define __SS3CHUNKEDSTREAM_H__
+
+#include <Arduino.h>
+
+// Read-only Stream over an HTTP/1.1 chunked body that strips the chunk framing
+// as it goes, so a keep-alive response streams through deserializeJson and its
+// filter instead of being buffered whole. Call drain() afterwards to consume
+// the rest of the body before the connection is reused.
+class SS3ChunkedStream : public Stream {
+    private:
+        Stream &source;
+        size_t remaining = 0; // bytes left in the current chunk
+        bool started = false; // a chunk's data has been read, so a CRLF comes before the next size
+        bool done = false;    // last chunk and trailers read
+        bool failed = false;  // timed out or bad framing, the connection can't be reused
+
+        int timedRead();
+        bool skipLine();
+        bool nextChunk();
+
+    public:
+        SS3ChunkedStream(Stream &source);
+        int available();
+        int read();
+        int peek();
+        size_t readBytes(char *out, size_t count);
+        size_t write(uint8_t);
+        void flush();
+        bool drain(); // true when the whole body was read
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "CircuitBreaker.h"
+#include "common.h"
+
+//
+// Private Member Functions
+//
+
+void SS3CircuitBreaker::trip(unsigned long retryAfterMS) {
+    if (retryAfterMS > 0) openForMS = min(retryAfterMS, (unsigned long)SS_BREAKER_MAX_RETRY_AFTER);
+    else openForMS = backoffMS;
+    backoffMS = min(backoffMS * 2, (unsigned long)SS_BREAKER_MAX_BACKOFF);
+
+    state = SS_BREAKER_OPEN;
+    openedAt = millis();
+    failures = 0;
+    probeInFlight = false;
+    metrics.trips++;
+    metrics.lastOpenMS = openForMS;
+    SS_ERROR_LINE("Circuit opened for %lums.", openForMS);
+}
+
+//
+// Public Member Functions
+//
+
+SS3CircuitBreaker::SS3CircuitBreaker() {
+    backoffMS = SS_BREAKER_BASE_BACKOFF;
+}
+
+bool SS3CircuitBreaker::allowRequest() {
+    if (state == SS_BREAKER_OPEN) {
+        if (millis() - openedAt < openForMS) {
+            metrics.rejected++;
+            return false;
+        }
+
+        SS_LOG_LINE("Circuit half-open, allowing probe request.");
+        metrics.totalOpenMS += openForMS;
+        state = SS_BREAKER_HALF_OPEN;
+        probeInFlight = false;
+    }
+
+    if (state == SS_BREAKER_HALF_OPEN) {
+        if (probeInFlight) {
+            metrics.rejected++;
+            return false;
+        }
+
+        probeInFlight = true;
+    }
+
+    return true;
+}
+
+void SS3CircuitBreaker::recordResult(int res, unsigned long retryAfterMS) {
+    if (res == 429) {
+        trip(retryAfterMS);
+        return;
+    }
+
+    if (res < 0 || res >= 500) {
+        failures++;
+        if (state == SS_BREAKER_HALF_OPEN || failures >= SS_BREAKER_FAILURE_THRESHOLD) trip(retryAfterMS);
+        return;
+    }
+
+    if (state != SS_BREAKER_CLOSED) SS_LOG_LINE("Circuit closed.");
+    state = SS_BREAKER_CLOSED;
+    failures = 0;
+    probeInFlight = false;
+    backoffMS = SS_BREAKER_BASE_BACKOFF;
+}
+
+void SS3CircuitBreaker::cancelRequest() {
+    // an allowed request that was never sent, so a half-open breaker can probe again
+    probeInFlight = false;
+}
+
+int SS3CircuitBreaker::getState() {
+    return state;
+}
+
+const SS3BreakerMetrics &SS3CircuitBreaker::getMetrics() {
+    return metrics;
+}
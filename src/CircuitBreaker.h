@@ -0,0 +1,46 @@
+#ifndef __SS3CIRCUITBREAKER_H__
+#define __SS3CIRCUITBREAKER_H__
+
+#include <Arduino.h>
+
+enum SS_BREAKER_STATE {
+    SS_BREAKER_CLOSED = 0,
+    SS_BREAKER_OPEN,
+    SS_BREAKER_HALF_OPEN
+};
+enum SS_ENDPOINT {
+    SS_ENDPOINT_AUTH = 0,
+    SS_ENDPOINT_API,
+    SS_ENDPOINT_OTHER,
+    SS_ENDPOINT_COUNT
+};
+
+struct SS3BreakerMetrics {
+    unsigned long trips = 0;       // times the breaker opened
+    unsigned long rejected = 0;    // requests failed fast while open
+    unsigned long lastOpenMS = 0;  // duration of the most recent open period
+    unsigned long totalOpenMS = 0; // sum of all completed open periods
+};
+
+class SS3CircuitBreaker {
+    private:
+        int state = SS_BREAKER_CLOSED;
+        int failures = 0;
+        bool probeInFlight = false;
+        unsigned long openedAt = 0;
+        unsigned long openForMS = 0;
+        unsigned long backoffMS;
+        SS3BreakerMetrics metrics;
+
+        void trip(unsigned long retryAfterMS);
+
+    public:
+        SS3CircuitBreaker();
+        bool allowRequest();
+        void recordResult(int res, unsigned long retryAfterMS = 0);
+        void cancelRequest();
+        int getState();
+        const SS3BreakerMetrics &getMetrics();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "ConnectionPool.h"
+#include "common.h"
+
+WiFiClientSecure *SS3ConnectionPool::clients[SS_ENDPOINT_COUNT] = {};
+SemaphoreHandle_t SS3ConnectionPool::locks[SS_ENDPOINT_COUNT] = {};
+unsigned long SS3ConnectionPool::lastUsed[SS_ENDPOINT_COUNT] = {};
+
+//
+// Public Member Functions
+//
+
+void SS3ConnectionPool::begin() {
+    if (locks[0]) return;
+
+    SS_LOG_LINE("Making connection pool.");
+    for (int x = 0; x < SS_ENDPOINT_COUNT; x++) {
+        locks[x] = xSemaphoreCreateMutex();
+        clients[x] = new WiFiClientSecure();
+    }
+
+    clients[SS_ENDPOINT_AUTH]->setCACert(SS_OAUTH_CA_CERT);
+    clients[SS_ENDPOINT_API]->setCACert(SS_API_CERT);
+    clients[SS_ENDPOINT_OTHER]->setInsecure();
+}
+
+WiFiClientSecure *SS3ConnectionPool::acquire(int endpoint) {
+    begin();
+    xSemaphoreTake(locks[endpoint], portMAX_DELAY);
+
+    WiFiClientSecure *client = clients[endpoint];
+    if (client->connected() && millis() - lastUsed[endpoint] >= SS_POOL_IDLE_TIMEOUT) {
+        SS_DETAIL_LINE("Pooled connection %i idle too long, reconnecting.", endpoint);
+        client->stop();
+    }
+
+    return client;
+}
+
+void SS3ConnectionPool::release(int endpoint, bool keepAlive) {
+    if (!keepAlive) clients[endpoint]->stop();
+    lastUsed[endpoint] = millis();
+    xSemaphoreGive(locks[endpoint]);
+}
+
+bool SS3ConnectionPool::canKeepAlive(int endpoint) {
+    // other endpoints can be any host, and HTTPClient reuses a connection without checking
+    return SS_POOL_KEEP_ALIVE && endpoint != SS_ENDPOINT_OTHER;
+}
+
+bool SS3ConnectionPool::isConnected(int endpoint) {
+    // acquire() reconnects a connection idle this long, so it costs a handshake
+    if (!locks[0] || millis() - lastUsed[endpoint] >= SS_POOL_IDLE_TIMEOUT) return false;
+    return clients[endpoint]->connected();
+}
+
+void SS3ConnectionPool::closeIdle(int keepEndpoint) {
+    if (!locks[0]) return;
+
+    // frees the TLS buffers of connections nobody is using right now
+    for (int x = 0; x < SS_ENDPOINT_COUNT; x++) {
+        if (x == keepEndpoint || xSemaphoreTake(locks[x], 0) != pdTRUE) continue;
+        if (clients[x]->connected()) {
+            SS_LOG_LINE("Closing idle pooled connection %i.", x);
+            clients[x]->stop();
+        }
+        xSemaphoreGive(locks[x]);
+    }
+}
+
+void SS3ConnectionPool::closeAll() {
+    if (!locks[0]) return;
+
+    SS_LOG_LINE("Closing pooled connections.");
+    for (int x = 0; x < SS_ENDPOINT_COUNT; x++) {
+        xSemaphoreTake(locks[x], portMAX_DELAY);
+        clients[x]->stop();
+        xSemaphoreGive(locks[x]);
+    }
+}
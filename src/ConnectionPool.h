@@ -0,0 +1,44 @@
+#ifndef __SS3CONNECTIONPOOL_H__
+#define __SS3CONNECTIONPOOL_H__
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include "CircuitBreaker.h"
+
+// One TLS client per endpoint, shared by every session so each additional
+// account doesn't pay for its own handshake and buffers. A client is held by
+// one request at a time; API and auth connections are kept alive between them.
+class SS3ConnectionPool {
+    private:
+        static WiFiClientSecure *clients[SS_ENDPOINT_COUNT];
+        static SemaphoreHandle_t locks[SS_ENDPOINT_COUNT];
+        static unsigned long lastUsed[SS_ENDPOINT_COUNT];
+
+    public:
+        static void begin();
+        static WiFiClientSecure *acquire(int endpoint);
+        static void release(int endpoint, bool keepAlive);
+        static bool canKeepAlive(int endpoint);
+        static bool isConnected(int endpoint);
+        static void closeIdle(int keepEndpoint = -1);
+        static void closeAll();
+};
+
+// Holds a pooled client for a scope.
+class SS3PooledClient {
+    private:
+        int endpoint;
+        WiFiClientSecure *client;
+        bool keepAlive;
+
+    public:
+        SS3PooledClient(int endpoint) : endpoint(endpoint), keepAlive(SS3ConnectionPool::canKeepAlive(endpoint)) {
+            client = SS3ConnectionPool::acquire(endpoint);
+        }
+        ~SS3PooledClient() { SS3ConnectionPool::release(endpoint, keepAlive); }
+        WiFiClientSecure &get() { return *client; }
+        bool isKeptAlive() { return keepAlive; }
+        void discard() { keepAlive = false; } // closed on release instead of reused
+};
+
+#endif
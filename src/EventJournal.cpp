@@ -0,0 +1,191 @@
+#include "EventJournal.h"
+#include "common.h"
+
+#if SS_JOURNAL_LITTLEFS
+    #include <LittleFS.h>
+    #define SS_JOURNAL_FS LittleFS
+#else
+    #include <SPIFFS.h>
+    #define SS_JOURNAL_FS SPIFFS
+#endif
+
+#define SS_JOURNAL_READ_CHUNK 16 // records read per file access during queries
+
+//
+// Private Member Functions
+//
+
+String SS3EventJournal::segmentPath(int index) {
+    return prefix + index + ".bin";
+}
+
+bool SS3EventJournal::readRecord(File &file, size_t index, SS3JournalRecord &record) {
+    if (!file.seek(index * sizeof(SS3JournalRecord))) return false;
+    return file.read((uint8_t *)&record, sizeof(record)) == sizeof(record);
+}
+
+void SS3EventJournal::dropRecords(size_t count) {
+    memmove(batch, batch + count, (batchCount - count) * sizeof(SS3JournalRecord));
+    batchCount -= count;
+}
+
+//
+// Public Member Functions
+//
+
+SS3EventJournal::SS3EventJournal(const String &pathPrefix) : prefix(pathPrefix) {}
+
+bool SS3EventJournal::begin() {
+    SS_LOG_LINE("Opening event journal.");
+    if (!SS_JOURNAL_FS.begin(true)) {
+        SS_ERROR_LINE("Error starting journal filesystem.");
+        return false;
+    }
+
+    // the segment whose last record has the highest sequence is where writing resumes
+    uint32_t highest = 0;
+    for (int x = 0; x < SS_JOURNAL_SEGMENTS; x++) {
+        File file = SS_JOURNAL_FS.open(segmentPath(x), "r");
+        if (!file) continue;
+
+        size_t count = file.size() / sizeof(SS3JournalRecord);
+        SS3JournalRecord last;
+        if (count > 0 && readRecord(file, count - 1, last) && last.sequence > highest) {
+            highest = last.sequence;
+            segment = x;
+            segmentCount = count;
+        }
+        file.close();
+    }
+
+    nextSequence = highest + 1;
+    lastFlush = millis();
+    SS_LOG_LINE("Journal resumes at segment %i, sequence %lu.", segment, (unsigned long)nextSequence);
+    return true;
+}
+
+bool SS3EventJournal::append(uint16_t cid, uint32_t timestamp, uint32_t subjectId, uint32_t sensorSerial, uint8_t sensorType) {
+    // still full from a failed flush, make room by losing the oldest record
+    if (batchCount >= SS_JOURNAL_BATCH && !flush()) {
+        SS_ERROR_LINE("Journal batch full, dropping record %lu.", (unsigned long)batch[0].sequence);
+        dropRecords(1);
+        droppedCount++;
+    }
+
+    SS3JournalRecord &record = batch[batchCount++];
+    record.sequence = nextSequence++;
+    record.timestamp = timestamp;
+    record.subjectId = subjectId;
+    record.sensorSerial = sensorSerial;
+    record.cid = cid;
+    record.sensorType = sensorType;
+    record.reserved = 0;
+
+    if (batchCount >= SS_JOURNAL_BATCH) return flush();
+    return true;
+}
+
+bool SS3EventJournal::flush() {
+    lastFlush = millis();
+    if (batchCount == 0) return true;
+
+    SS_LOG_LINE("Flushing %u journal records.", batchCount);
+    while (batchCount > 0) {
+        if (segmentCount >= SS_JOURNAL_SEGMENT_RECORDS) {
+            // move on and overwrite the oldest segment
+            segment = (segment + 1) % SS_JOURNAL_SEGMENTS;
+            segmentCount = 0;
+        }
+
+        File file = SS_JOURNAL_FS.open(segmentPath(segment), segmentCount == 0 ? "w" : "a");
+        if (!file) {
+            SS_ERROR_LINE("Failed to open %s.", segmentPath(segment).c_str());
+            return false;
+        }
+
+        size_t n = min(batchCount, (size_t)(SS_JOURNAL_SEGMENT_RECORDS - segmentCount));
+        size_t bytes = file.write((const uint8_t *)batch, n * sizeof(SS3JournalRecord));
+        file.close();
+
+        // whatever made it to flash leaves the batch, so a retry doesn't write it twice
+        size_t written = bytes / sizeof(SS3JournalRecord);
+        dropRecords(written);
+        segmentCount += written;
+
+        if (written != n) {
+            SS_ERROR_LINE("Failed to write journal records.");
+            segmentCount = SS_JOURNAL_SEGMENT_RECORDS; // part of a record may trail the file, start the next segment
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SS3EventJournal::loop() {
+    if (batchCount > 0 && millis() - lastFlush >= SS_JOURNAL_FLUSH_INTERVAL) flush();
+}
+
+size_t SS3EventJournal::query(uint32_t from, uint32_t to, int cid, SS3JournalCallback callback, void *context) {
+    SS_LOG_LINE("Querying journal.");
+    size_t matches = 0;
+    SS3JournalRecord chunk[SS_JOURNAL_READ_CHUNK];
+
+    // oldest segment first, streaming a chunk at a time
+    for (int x = 1; x <= SS_JOURNAL_SEGMENTS; x++) {
+        int index = (segment + x) % SS_JOURNAL_SEGMENTS;
+        File file = SS_JOURNAL_FS.open(segmentPath(index), "r");
+        if (!file) continue;
+
+        size_t count = file.size() / sizeof(SS3JournalRecord);
+        SS3JournalRecord first, last;
+        if (
+            count == 0 ||
+            !readRecord(file, 0, first) ||
+            !readRecord(file, count - 1, last) ||
+            last.timestamp < from ||
+            first.timestamp > to
+        ) {
+            file.close();
+            continue;
+        }
+
+        file.seek(0);
+        for (size_t read = 0; read < count;) {
+            size_t n = file.read((uint8_t *)chunk, min(count - read, (size_t)SS_JOURNAL_READ_CHUNK) * sizeof(SS3JournalRecord)) / sizeof(SS3JournalRecord);
+            if (n == 0) break;
+            read += n;
+
+            for (size_t y = 0; y < n; y++) {
+                const SS3JournalRecord &record = chunk[y];
+                if (record.timestamp < from || record.timestamp > to) continue;
+                if (cid != SS_JOURNAL_ANY_CID && record.cid != cid) continue;
+                matches++;
+                if (!callback(record, context)) {
+                    file.close();
+                    return matches;
+                }
+            }
+        }
+        file.close();
+    }
+
+    // records still waiting to be written
+    for (size_t x = 0; x < batchCount; x++) {
+        const SS3JournalRecord &record = batch[x];
+        if (record.timestamp < from || record.timestamp > to) continue;
+        if (cid != SS_JOURNAL_ANY_CID && record.cid != cid) continue;
+        matches++;
+        if (!callback(record, context)) break;
+    }
+
+    return matches;
+}
+
+uint32_t SS3EventJournal::lastSequence() {
+    return nextSequence - 1;
+}
+
+unsigned long SS3EventJournal::getDroppedCount() {
+    return droppedCount;
+}
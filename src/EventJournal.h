@@ -0,0 +1,52 @@
+#ifndef __SS3EVENTJOURNAL_H__
+#define __SS3EVENTJOURNAL_H__
+
+#include <Arduino.h>
+#include <FS.h>
+#include "common.h"
+
+#define SS_JOURNAL_ANY_CID -1
+
+struct __attribute__((packed)) SS3JournalRecord {
+    uint32_t sequence;
+    uint32_t timestamp;    // eventTimestamp, unix seconds
+    uint32_t subjectId;    // sid of the system the event came from
+    uint32_t sensorSerial; // hex serial as a number, 0 when the event has no sensor
+    uint16_t cid;
+    uint8_t sensorType;
+    uint8_t reserved;
+};
+
+// Return false to stop a query early.
+typedef bool (*SS3JournalCallback)(const SS3JournalRecord &record, void *context);
+
+// Append-only event log in a ring of fixed-size segment files. Records are
+// batched in RAM and written together to limit flash wear, so up to
+// SS_JOURNAL_BATCH events can be lost on power failure.
+class SS3EventJournal {
+    private:
+        String prefix;
+        SS3JournalRecord batch[SS_JOURNAL_BATCH];
+        size_t batchCount = 0;
+        uint32_t nextSequence = 1;
+        int segment = 0;
+        size_t segmentCount = 0; // records in the current segment
+        unsigned long lastFlush = 0;
+        unsigned long droppedCount = 0;
+
+        String segmentPath(int index);
+        bool readRecord(File &file, size_t index, SS3JournalRecord &record);
+        void dropRecords(size_t count); // removes the oldest count records from the batch
+
+    public:
+        SS3EventJournal(const String &pathPrefix = SS_JOURNAL_PREFIX);
+        bool begin();
+        bool append(uint16_t cid, uint32_t timestamp, uint32_t subjectId, uint32_t sensorSerial, uint8_t sensorType);
+        bool flush();
+        void loop();
+        size_t query(uint32_t from, uint32_t to, int cid, SS3JournalCallback callback, void *context = nullptr);
+        uint32_t lastSequence();
+        unsigned long getDroppedCount(); // records lost while flash wouldn't take a flush
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "Fixture.h"
+
+SS3BufferStream::SS3BufferStream(const uint8_t *buffer, size_t length) : buffer(buffer), length(length) {}
+
+int SS3BufferStream::available() {
+    return length - position;
+}
+
+int SS3BufferStream::read() {
+    if (position >= length) return -1;
+    return buffer[position++];
+}
+
+int SS3BufferStream::peek() {
+    if (position >= length) return -1;
+    return buffer[position];
+}
+
+size_t SS3BufferStream::readBytes(char *out, size_t count) {
+    size_t n = min(count, length - position);
+    memcpy(out, buffer + position, n);
+    position += n;
+    return n;
+}
+
+size_t SS3BufferStream::write(uint8_t) {
+    return 0; // read only
+}
+
+void SS3BufferStream::flush() {}
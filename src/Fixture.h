@@ -0,0 +1,32 @@
+#ifndef __SS3FIXTURE_H__
+#define __SS3FIXTURE_H__
+
+#include <Arduino.h>
+
+// A canned response served by SS3AuthManager::request instead of the network.
+struct SS3Fixture {
+    bool post;        // method to match
+    const char *path; // matched as a substring of the request url
+    int status;
+    const char *body;
+};
+
+// Read-only Stream over a caller-owned buffer, so fixtures go through the same
+// deserializeJson(doc, Stream) path as a live response without copying.
+class SS3BufferStream : public Stream {
+    private:
+        const uint8_t *buffer;
+        size_t length;
+        size_t position = 0;
+
+    public:
+        SS3BufferStream(const uint8_t *buffer, size_t length);
+        int available();
+        int read();
+        int peek();
+        size_t readBytes(char *out, size_t count);
+        size_t write(uint8_t);
+        void flush();
+};
+
+#endif
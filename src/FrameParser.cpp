@@ -0,0 +1,78 @@
+#include <string.h>
+#include "FrameParser.h"
+
+SS3FrameStats SS3FrameParser::stats;
+
+//
+// Private Member Functions
+//
+
+int SS3FrameParser::reject(unsigned long &counter, const char *why, const char **reason) {
+    counter++;
+    if (reason) *reason = why; // logged by the caller
+    return SS_FRAME_INVALID;
+}
+
+StaticJsonDocument<256> SS3FrameParser::makeFilter() {
+    StaticJsonDocument<256> filter;
+    filter["type"] = true;
+    filter["data"]["eventCid"] = true;
+    filter["data"]["sid"] = true;
+    filter["data"]["sensorSerial"] = true;
+    filter["data"]["sensorType"] = true;
+    filter["data"]["sensorName"] = true;
+    filter["data"]["eventTimestamp"] = true;
+    filter["data"]["messageSubject"] = true;
+    return filter;
+}
+
+const JsonDocument &SS3FrameParser::getFilter() {
+    // built on first use, a namespace-scope document could be constructed after global SimpliSafe3 objects use it
+    static const StaticJsonDocument<256> filter = makeFilter();
+    return filter;
+}
+
+//
+// Public Member Functions
+//
+
+int SS3FrameParser::parse(uint8_t *payload, size_t length, JsonDocument &doc, const char **reason) {
+    stats.frames++;
+    if (!payload || length == 0) return reject(stats.malformed, "empty", reason);
+    if (length > SS_FRAME_MAX_LENGTH) return reject(stats.oversized, "too long", reason);
+
+    DeserializationError err = deserializeJson(
+        doc,
+        payload,
+        length,
+        DeserializationOption::Filter(getFilter()),
+        DeserializationOption::NestingLimit(SS_FRAME_NESTING_LIMIT)
+    );
+    switch (err.code()) {
+        case DeserializationError::Ok: break;
+        case DeserializationError::TooDeep: return reject(stats.tooDeep, err.c_str(), reason);
+        case DeserializationError::NoMemory: return reject(stats.noMemory, err.c_str(), reason);
+        default: return reject(stats.malformed, err.c_str(), reason);
+    }
+
+    const char *type = doc["type"];
+    if (!type) return reject(stats.malformed, "no type", reason);
+
+    if (strcmp(type, "com.simplisafe.event.standard") == 0) {
+        if (!doc["data"].is<JsonObject>()) return reject(stats.malformed, "event without data", reason);
+        return SS_FRAME_EVENT;
+    }
+    if (strcmp(type, "com.simplisafe.service.hello") == 0) return SS_FRAME_HELLO;
+    if (strcmp(type, "com.simplisafe.service.registered") == 0) return SS_FRAME_REGISTERED;
+    if (strcmp(type, "com.simplisafe.namespace.subscribed") == 0) return SS_FRAME_SUBSCRIBED;
+
+    return SS_FRAME_OTHER;
+}
+
+const SS3FrameStats &SS3FrameParser::getStats() {
+    return stats;
+}
+
+void SS3FrameParser::resetStats() {
+    stats = SS3FrameStats();
+}
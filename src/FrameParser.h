@@ -0,0 +1,51 @@
+#ifndef __SS3FRAMEPARSER_H__
+#define __SS3FRAMEPARSER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+// no common.h here, so the parser also builds on a host for fuzzing
+#ifndef SS_FRAME_MAX_LENGTH
+#define SS_FRAME_MAX_LENGTH 8192 // bytes, the server's events are well under this
+#endif
+#ifndef SS_FRAME_NESTING_LIMIT
+#define SS_FRAME_NESTING_LIMIT 8 // events nest 2 deep, this leaves room for new fields
+#endif
+
+enum SS_FRAME {
+    SS_FRAME_INVALID = -1,
+    SS_FRAME_OTHER = 0,
+    SS_FRAME_HELLO,
+    SS_FRAME_REGISTERED,
+    SS_FRAME_SUBSCRIBED,
+    SS_FRAME_EVENT
+};
+
+struct SS3FrameStats {
+    unsigned long frames = 0;    // everything passed to parse()
+    unsigned long oversized = 0; // longer than SS_FRAME_MAX_LENGTH
+    unsigned long tooDeep = 0;   // nested past SS_FRAME_NESTING_LIMIT
+    unsigned long noMemory = 0;  // didn't fit the frame document
+    unsigned long malformed = 0; // bad JSON, or JSON that isn't a frame
+};
+
+// Turns a WebSocket text frame into a document and says what kind of frame it
+// is. Frames come off the network, so anything too long, too deep, or that
+// doesn't parse to an object with a type is rejected before a listener sees it.
+// Only the fields listeners read are kept.
+class SS3FrameParser {
+    private:
+        static SS3FrameStats stats;
+
+        static int reject(unsigned long &counter, const char *why, const char **reason);
+        static StaticJsonDocument<256> makeFilter();
+        static const JsonDocument &getFilter();
+
+    public:
+        static int parse(uint8_t *payload, size_t length, JsonDocument &doc, const char **reason = nullptr); // payload is parsed in place
+        static const SS3FrameStats &getStats();
+        static void resetStats();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "HeapMonitor.h"
+#include <esp_heap_caps.h>
+
+//
+// Public Member Functions
+//
+
+SS3HeapMonitor::SS3HeapMonitor(const SS3HeapLimits &limits) : limits(limits) {}
+
+const SS3HeapSample &SS3HeapMonitor::sample() {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+    last.ms = millis();
+    last.freeBytes = info.total_free_bytes;
+    last.largestBlock = info.largest_free_block;
+    last.allocatedBlocks = info.allocated_blocks;
+    last.minimumFree = info.minimum_free_bytes;
+    return last;
+}
+
+void SS3HeapMonitor::setBaseline() {
+    baseline = sample();
+    hasBaseline = true;
+    SS_LOG_LINE(
+        "Heap baseline: %u free, %u largest block, %u allocations, %u minimum free.",
+        baseline.freeBytes,
+        baseline.largestBlock,
+        baseline.allocatedBlocks,
+        baseline.minimumFree
+    );
+}
+
+bool SS3HeapMonitor::check() {
+    if (!hasBaseline) return true;
+
+    bool healthy = true;
+    if (last.largestBlock + limits.largestBlock < baseline.largestBlock) {
+        SS_ERROR_LINE("Largest free block shrank from %u to %u bytes.", baseline.largestBlock, last.largestBlock);
+        healthy = false;
+    }
+
+    if (last.allocatedBlocks > baseline.allocatedBlocks + limits.allocations) {
+        SS_ERROR_LINE("Live allocations grew from %u to %u.", baseline.allocatedBlocks, last.allocatedBlocks);
+        healthy = false;
+    }
+
+    if (last.minimumFree + limits.minimumFree < baseline.minimumFree) {
+        SS_ERROR_LINE("Minimum free heap fell from %u to %u bytes.", baseline.minimumFree, last.minimumFree);
+        healthy = false;
+    }
+
+    return healthy;
+}
+
+const SS3HeapSample &SS3HeapMonitor::getBaseline() {
+    return baseline;
+}
+
+const SS3HeapSample &SS3HeapMonitor::getLast() {
+    return last;
+}
+
+void SS3HeapMonitor::printJson(Print &out, const char *label) {
+    // one object per line, same as SS3Profiler::printJson, so long runs can be plotted
+    out.printf(
+        "{\"label\":\"%s\",\"ms\":%lu,\"free\":%u,\"largestBlock\":%u,\"allocations\":%u,\"minimumFree\":%u,"
+        "\"largestBlockDrift\":%ld,\"allocationDrift\":%ld,\"minimumFreeDrift\":%ld}\n",
+        label,
+        last.ms,
+        last.freeBytes,
+        last.largestBlock,
+        last.allocatedBlocks,
+        last.minimumFree,
+        (long)last.largestBlock - (long)baseline.largestBlock,
+        (long)last.allocatedBlocks - (long)baseline.allocatedBlocks,
+        (long)last.minimumFree - (long)baseline.minimumFree
+    );
+}
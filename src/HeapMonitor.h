@@ -0,0 +1,41 @@
+#ifndef __SS3HEAPMONITOR_H__
+#define __SS3HEAPMONITOR_H__
+
+#include <Arduino.h>
+#include "common.h"
+
+struct SS3HeapSample {
+    unsigned long ms = 0;
+    size_t freeBytes = 0;
+    size_t largestBlock = 0;    // biggest single allocation that would still succeed
+    size_t allocatedBlocks = 0; // live allocations
+    size_t minimumFree = 0;     // low-water mark since boot
+};
+
+struct SS3HeapLimits {
+    size_t largestBlock = SS_HEAP_DRIFT_LARGEST_BLOCK;
+    size_t allocations = SS_HEAP_DRIFT_ALLOCATIONS;
+    size_t minimumFree = SS_HEAP_DRIFT_MINIMUM_FREE;
+};
+
+// Samples heap health and reports when it drifts from a baseline. Take the
+// baseline once pools, sockets and caches have warmed up, then sample at a
+// quiet point between operations so in-flight buffers don't count as leaks.
+class SS3HeapMonitor {
+    private:
+        SS3HeapLimits limits;
+        SS3HeapSample baseline;
+        SS3HeapSample last;
+        bool hasBaseline = false;
+
+    public:
+        SS3HeapMonitor(const SS3HeapLimits &limits = SS3HeapLimits());
+        const SS3HeapSample &sample();
+        void setBaseline();
+        bool check(); // false once any metric has drifted past its limit
+        const SS3HeapSample &getBaseline();
+        const SS3HeapSample &getLast();
+        void printJson(Print &out, const char *label);
+};
+
+#endif
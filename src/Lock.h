@@ -0,0 +1,18 @@
+#ifndef __SS3LOCK_H__
+#define __SS3LOCK_H__
+
+#include <Arduino.h>
+
+// Holds a recursive lock for a scope. Locks are always taken in this order:
+// a SimpliSafe3's commandLock, a session's socketLock, a SimpliSafe3's stateLock,
+// then the auth manager's lock.
+class SS3Lock {
+    private:
+        SemaphoreHandle_t mutex;
+
+    public:
+        SS3Lock(SemaphoreHandle_t mutex) : mutex(mutex) { xSemaphoreTakeRecursive(mutex, portMAX_DELAY); }
+        ~SS3Lock() { xSemaphoreGiveRecursive(mutex); }
+};
+
+#endif
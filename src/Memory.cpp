@@ -0,0 +1,87 @@
+#include "Memory.h"
+#include "common.h"
+#include <esp_heap_caps.h>
+
+const size_t SS_PARSE_SLOT_SIZES[SS_PARSE_SLOT_COUNT] = {
+    SS_PARSE_TOKEN_SIZE,
+    SS_PARSE_FRAME_SIZE,
+    SS_PARSE_IDENTIFY_SIZE
+};
+
+size_t SS3Memory::reserve = SS_HEAP_RESERVE;
+bool SS3Memory::low = false;
+unsigned long SS3Memory::lowCount = 0;
+size_t SS3Memory::lowFree = 0;
+size_t SS3Memory::lowBlock = 0;
+DynamicJsonDocument *SS3Memory::documents[SS_PARSE_SLOT_COUNT] = {};
+SemaphoreHandle_t SS3Memory::documentLocks[SS_PARSE_SLOT_COUNT] = {};
+
+//
+// Public Member Functions
+//
+
+void SS3Memory::begin() {
+    if (documents[0]) return;
+
+    SS_LOG_LINE("Allocating parse documents.");
+    for (int x = 0; x < SS_PARSE_SLOT_COUNT; x++) {
+        documents[x] = new DynamicJsonDocument(SS_PARSE_SLOT_SIZES[x]);
+        documentLocks[x] = xSemaphoreCreateMutex();
+    }
+}
+
+bool SS3Memory::allows(size_t cost, size_t block, const char *what) {
+    size_t freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (freeBytes >= reserve + cost && largest >= block) {
+        if (low) SS_LOG_LINE("Heap recovered, %u bytes free.", freeBytes);
+        low = false;
+        return true;
+    }
+
+    // count and log each shortage once, not every poll that runs into it
+    if (!low) {
+        low = true;
+        lowCount++;
+        lowFree = freeBytes;
+        lowBlock = largest;
+        SS_ERROR_LINE(
+            "Deferring %s, %u bytes free with a largest block of %u, needs %u plus %u reserved.",
+            what,
+            freeBytes,
+            largest,
+            cost,
+            reserve
+        );
+    }
+
+    return false;
+}
+
+void SS3Memory::setReserve(size_t bytes) {
+    SS_LOG_LINE("Reserving %u bytes of heap for the app.", bytes);
+    reserve = bytes;
+}
+
+unsigned long SS3Memory::getLowMemoryCount() {
+    return lowCount;
+}
+
+size_t SS3Memory::getLowFree() {
+    return lowFree;
+}
+
+size_t SS3Memory::getLowBlock() {
+    return lowBlock;
+}
+
+JsonDocument &SS3Memory::acquireDocument(int slot) {
+    begin();
+    xSemaphoreTake(documentLocks[slot], portMAX_DELAY);
+    documents[slot]->clear();
+    return *documents[slot];
+}
+
+void SS3Memory::releaseDocument(int slot) {
+    xSemaphoreGive(documentLocks[slot]);
+}
@@ -0,0 +1,49 @@
+#ifndef __SS3MEMORY_H__
+#define __SS3MEMORY_H__
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+enum SS_PARSE_SLOT {
+    SS_PARSE_SLOT_TOKEN = 0,
+    SS_PARSE_SLOT_FRAME,
+    SS_PARSE_SLOT_IDENTIFY,
+    SS_PARSE_SLOT_COUNT
+};
+
+// Heap checks shared by every session, plus the parse documents they reuse.
+// Documents are allocated once by begin(), while the heap is still in one piece.
+class SS3Memory {
+    private:
+        static size_t reserve;
+        static bool low;
+        static unsigned long lowCount;
+        static size_t lowFree;
+        static size_t lowBlock;
+        static DynamicJsonDocument *documents[SS_PARSE_SLOT_COUNT];
+        static SemaphoreHandle_t documentLocks[SS_PARSE_SLOT_COUNT];
+
+    public:
+        static void begin();
+        static bool allows(size_t cost, size_t block, const char *what);
+        static void setReserve(size_t bytes);
+        static unsigned long getLowMemoryCount(); // bumps each time the heap runs short
+        static size_t getLowFree();
+        static size_t getLowBlock();
+        static JsonDocument &acquireDocument(int slot);
+        static void releaseDocument(int slot);
+};
+
+// Holds a pooled document for a scope, cleared and ready to use.
+class SS3PooledDocument {
+    private:
+        int slot;
+        JsonDocument &doc;
+
+    public:
+        SS3PooledDocument(int slot) : slot(slot), doc(SS3Memory::acquireDocument(slot)) {}
+        ~SS3PooledDocument() { SS3Memory::releaseDocument(slot); }
+        JsonDocument &get() { return doc; }
+};
+
+#endif
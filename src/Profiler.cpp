@@ -0,0 +1,129 @@
+#include "Profiler.h"
+#include "common.h"
+#include <esp_heap_caps.h>
+
+const char* SS_PROFILE_OP_NAMES[SS_PROFILE_OP_COUNT] = {
+    "getAlarmState",
+    "getLockState",
+    "setLockState",
+    "refreshToken",
+    "eventDispatch"
+};
+
+SS3ProfileStats SS3Profiler::stats[SS_PROFILE_OP_COUNT];
+int SS3Profiler::currentOp = -1;
+int SS3Profiler::depth = 0;
+unsigned long SS3Profiler::startUS = 0;
+unsigned long SS3Profiler::parseStartUS = 0;
+size_t SS3Profiler::startBlocks = 0;
+size_t SS3Profiler::startAllocated = 0;
+size_t SS3Profiler::startFree = 0;
+size_t SS3Profiler::startMinFree = 0;
+
+//
+// Private Member Functions
+//
+
+void SS3Profiler::sampleHeap() {
+    if (currentOp < 0) return;
+    SS3ProfileStats &s = stats[currentOp];
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+    if (info.allocated_blocks > startBlocks)
+        s.peakBlocks = max(s.peakBlocks, (unsigned long)(info.allocated_blocks - startBlocks));
+    if (info.total_allocated_bytes > startAllocated)
+        s.peakBytes = max(s.peakBytes, (unsigned long)(info.total_allocated_bytes - startAllocated));
+
+    // the heap low-water mark catches peaks between samples, but only when it moves
+    if (info.minimum_free_bytes < startMinFree)
+        s.peakBytes = max(s.peakBytes, (unsigned long)(startFree - info.minimum_free_bytes));
+}
+
+//
+// Public Member Functions
+//
+
+void SS3Profiler::begin(int op) {
+    if (depth++ > 0) return; // only the outermost operation is measured
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    startBlocks = info.allocated_blocks;
+    startAllocated = info.total_allocated_bytes;
+    startFree = info.total_free_bytes;
+    startMinFree = info.minimum_free_bytes;
+
+    currentOp = op;
+    startUS = micros();
+}
+
+void SS3Profiler::end() {
+    if (depth == 0 || --depth > 0) return;
+
+    unsigned long elapsed = micros() - startUS;
+    SS3ProfileStats &s = stats[currentOp];
+    sampleHeap();
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    s.retainedBytes += (long)info.total_allocated_bytes - (long)startAllocated;
+
+    s.calls++;
+    s.totalUS += elapsed;
+    s.maxUS = max(s.maxUS, elapsed);
+    currentOp = -1;
+}
+
+void SS3Profiler::beginParse() {
+    parseStartUS = micros();
+}
+
+void SS3Profiler::endParse(size_t responseBytes, size_t docBytes) {
+    if (currentOp < 0) return;
+
+    unsigned long elapsed = micros() - parseStartUS;
+    SS3ProfileStats &s = stats[currentOp];
+    s.parseUS += elapsed;
+    s.maxParseUS = max(s.maxParseUS, elapsed);
+    s.responseBytes += responseBytes;
+    s.docBytes += docBytes;
+    sampleHeap(); // parsed document, client and response are all still alive here
+}
+
+const SS3ProfileStats &SS3Profiler::getStats(int op) {
+    return stats[op];
+}
+
+void SS3Profiler::reset() {
+    for (int x = 0; x < SS_PROFILE_OP_COUNT; x++) stats[x] = SS3ProfileStats();
+    currentOp = -1;
+    depth = 0;
+}
+
+void SS3Profiler::printJson(Print &out, const char *label) {
+    // one object per line so runs can be appended to a log and diffed between versions
+    out.printf("{\"version\":\"%s\",\"label\":\"%s\",\"minFreeHeap\":%u,\"ops\":{", SS_VERSION, label, esp_get_minimum_free_heap_size());
+    for (int x = 0; x < SS_PROFILE_OP_COUNT; x++) {
+        const SS3ProfileStats &s = stats[x];
+        unsigned long calls = max(s.calls, 1UL);
+        out.printf(
+            "%s\"%s\":{\"calls\":%lu,\"avgUS\":%llu,\"maxUS\":%lu,\"avgParseUS\":%llu,\"maxParseUS\":%lu,"
+            "\"avgResponseBytes\":%llu,\"avgDocBytes\":%llu,\"peakBlocks\":%lu,\"peakBytes\":%lu,\"retainedBytes\":%ld}",
+            x == 0 ? "" : ",",
+            SS_PROFILE_OP_NAMES[x],
+            s.calls,
+            s.totalUS / calls,
+            s.maxUS,
+            s.parseUS / calls,
+            s.maxParseUS,
+            s.responseBytes / calls,
+            s.docBytes / calls,
+            s.peakBlocks,
+            s.peakBytes,
+            s.retainedBytes
+        );
+    }
+    out.println("}}");
+}
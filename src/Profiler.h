@@ -0,0 +1,69 @@
+#ifndef __SS3PROFILER_H__
+#define __SS3PROFILER_H__
+
+#include <Arduino.h>
+#include "common.h"
+
+enum SS_PROFILE_OP {
+    SS_PROFILE_GET_ALARM_STATE = 0,
+    SS_PROFILE_GET_LOCK_STATE,
+    SS_PROFILE_SET_LOCK_STATE,
+    SS_PROFILE_REFRESH_TOKEN,
+    SS_PROFILE_EVENT_DISPATCH,
+    SS_PROFILE_OP_COUNT
+};
+
+struct SS3ProfileStats {
+    unsigned long calls = 0;
+    unsigned long long totalUS = 0;
+    unsigned long maxUS = 0;
+    unsigned long long parseUS = 0;    // time spent in deserializeJson
+    unsigned long maxParseUS = 0;
+    unsigned long long responseBytes = 0; // bytes fed to the parser
+    unsigned long long docBytes = 0;   // JsonDocument memory used by parsed responses
+    unsigned long peakBlocks = 0;      // most heap blocks live at once above the call's baseline
+    unsigned long peakBytes = 0;       // most heap bytes in use at once above the call's baseline
+    long retainedBytes = 0;            // heap still held once calls returned, should stay 0
+};
+
+class SS3Profiler {
+    private:
+        static SS3ProfileStats stats[SS_PROFILE_OP_COUNT];
+        static int currentOp;
+        static int depth;
+        static unsigned long startUS;
+        static unsigned long parseStartUS;
+        static size_t startBlocks;
+        static size_t startAllocated;
+        static size_t startFree;
+        static size_t startMinFree;
+
+        static void sampleHeap();
+
+    public:
+        static void begin(int op);
+        static void end();
+        static void beginParse();
+        static void endParse(size_t responseBytes, size_t docBytes);
+        static const SS3ProfileStats &getStats(int op);
+        static void reset();
+        static void printJson(Print &out, const char *label = "");
+};
+
+class SS3ProfileScope {
+    public:
+        SS3ProfileScope(int op) { SS3Profiler::begin(op); }
+        ~SS3ProfileScope() { SS3Profiler::end(); }
+};
+
+#if SS_PROFILE
+    #define SS_PROFILE_SCOPE(op) SS3ProfileScope __ssProfileScope(op)
+    #define SS_PROFILE_PARSE_BEGIN() SS3Profiler::beginParse()
+    #define SS_PROFILE_PARSE_END(responseBytes, docBytes) SS3Profiler::endParse(responseBytes, docBytes)
+#else
+    #define SS_PROFILE_SCOPE(op)
+    #define SS_PROFILE_PARSE_BEGIN()
+    #define SS_PROFILE_PARSE_END(responseBytes, docBytes)
+#endif
+
+#endif
@@ -0,0 +1,18 @@
+#include "Request.h"
+#include <stdarg.h>
+
+//
+// Public Member Functions
+//
+
+SS3Url::SS3Url(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length < 0 || length >= (int)sizeof(buffer)) {
+        SS_ERROR_LINE("URL longer than %i characters: %s", SS_URL_MAX, buffer);
+        buffer[0] = '\0';
+    }
+}
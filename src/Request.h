@@ -0,0 +1,23 @@
+#ifndef __SS3REQUEST_H__
+#define __SS3REQUEST_H__
+
+#include <Arduino.h>
+#include "common.h"
+
+struct SS3Header {
+    const char *name;
+    const char *value;
+};
+
+// Formats a request URL into a fixed buffer instead of concatenating Strings.
+// A URL that doesn't fit is left empty, which request() refuses.
+class SS3Url {
+    private:
+        char buffer[SS_URL_MAX];
+
+    public:
+        SS3Url(const char *format, ...) __attribute__((format(printf, 2, 3)));
+        const char *c_str() const { return buffer; }
+};
+
+#endif
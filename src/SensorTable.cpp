@@ -0,0 +1,130 @@
+#include "SensorTable.h"
+#include "common.h"
+
+// cids that mean the sensor itself tripped, see eventCids in README.md
+const uint16_t SS_SENSOR_TRIGGER_CIDS[5] = {
+    1134, // alarm triggered by sensor
+    1170, // camera motion
+    1409, // motion
+    1429, // entry
+    1458  // doorbell
+};
+
+//
+// Private Member Functions
+//
+
+size_t SS3SensorTable::slot(uint32_t serial) {
+    // fibonacci hash, linear probe; the index is never more than half full
+    size_t x = (serial * 2654435761u) & (SS_SENSOR_INDEX_SIZE - 1);
+    while (index[x] != SS_SENSOR_INDEX_EMPTY && sensors[index[x]].serial != serial) {
+        x = (x + 1) & (SS_SENSOR_INDEX_SIZE - 1);
+    }
+    return x;
+}
+
+uint16_t SS3SensorTable::addName(const char *name) {
+    if (!name) return SS_SENSOR_NO_NAME;
+
+    size_t length = strlen(name) + 1;
+    if (namesUsed + length > SS_SENSOR_NAME_POOL) {
+        SS_ERROR_LINE("Sensor name pool full, dropping name %s.", name);
+        return SS_SENSOR_NO_NAME;
+    }
+
+    uint16_t id = namesUsed;
+    memcpy(names + namesUsed, name, length);
+    namesUsed += length;
+    return id;
+}
+
+//
+// Public Member Functions
+//
+
+SS3SensorTable::SS3SensorTable() {
+    clear();
+}
+
+void SS3SensorTable::clear() {
+    memset(index, SS_SENSOR_INDEX_EMPTY, sizeof(index));
+    count = 0;
+    namesUsed = 0;
+}
+
+SS3Sensor *SS3SensorTable::find(uint32_t serial) {
+    size_t x = slot(serial);
+    if (index[x] == SS_SENSOR_INDEX_EMPTY) return nullptr;
+    return &sensors[index[x]];
+}
+
+SS3Sensor *SS3SensorTable::upsert(uint32_t serial, uint8_t type, const char *name) {
+    if (serial == 0) return nullptr;
+
+    size_t x = slot(serial);
+    if (index[x] != SS_SENSOR_INDEX_EMPTY) {
+        SS3Sensor &sensor = sensors[index[x]];
+        sensor.type = type;
+        if (sensor.nameId == SS_SENSOR_NO_NAME) sensor.nameId = addName(name);
+        return &sensor;
+    }
+
+    if (count >= SS_MAX_SENSORS) {
+        SS_ERROR_LINE("Sensor table full, ignoring sensor %lx.", (unsigned long)serial);
+        return nullptr;
+    }
+
+    SS3Sensor &sensor = sensors[count];
+    sensor.serial = serial;
+    sensor.type = type;
+    sensor.state = SS_SENSOR_STATE_UNKNOWN;
+    sensor.nameId = addName(name);
+    sensor.lastCid = 0;
+    sensor.lastEventTime = 0;
+    index[x] = count++;
+    return &sensor;
+}
+
+bool SS3SensorTable::patch(uint32_t serial, uint8_t type, uint16_t cid, uint32_t timestamp, const char *name) {
+    SS3Sensor *sensor = find(serial);
+    if (!sensor) sensor = upsert(serial, type, name); // new since the last full refresh
+    if (!sensor) return false;
+
+    sensor->lastCid = cid;
+    sensor->lastEventTime = timestamp;
+    // sensors don't report going quiet, so any other event for the sensor means it's clear again
+    sensor->state = isTriggerCid(cid) ? SS_SENSOR_STATE_TRIGGERED : SS_SENSOR_STATE_CLEAR;
+    SS_DETAIL_LINE("Patched sensor %lx with event %u.", (unsigned long)serial, cid);
+    return true;
+}
+
+void SS3SensorTable::settle(SS3Sensor &sensor, uint32_t now) {
+    // entries from a full refresh have no event time, the server's triggered flag stands until the next one
+    if (sensor.state != SS_SENSOR_STATE_TRIGGERED || sensor.lastEventTime == 0 || now <= sensor.lastEventTime) return;
+    if (now - sensor.lastEventTime >= SS_SENSOR_TRIGGER_HOLD) sensor.state = SS_SENSOR_STATE_CLEAR;
+}
+
+const char *SS3SensorTable::getName(const SS3Sensor &sensor) {
+    if (sensor.nameId == SS_SENSOR_NO_NAME) return "";
+    return names + sensor.nameId;
+}
+
+size_t SS3SensorTable::size() {
+    return count;
+}
+
+const SS3Sensor &SS3SensorTable::at(size_t x) {
+    return sensors[x];
+}
+
+uint32_t SS3SensorTable::parseSerial(const char *serial) {
+    if (!serial) return 0;
+    return strtoul(serial, nullptr, 16);
+}
+
+bool SS3SensorTable::isTriggerCid(uint16_t cid) {
+    for (int x = 0; x < sizeof(SS_SENSOR_TRIGGER_CIDS) / sizeof(SS_SENSOR_TRIGGER_CIDS[0]); x++) {
+        if (SS_SENSOR_TRIGGER_CIDS[x] == cid) return true;
+    }
+    return false;
+}
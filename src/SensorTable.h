@@ -0,0 +1,54 @@
+#ifndef __SS3SENSORTABLE_H__
+#define __SS3SENSORTABLE_H__
+
+#include <Arduino.h>
+#include "common.h"
+
+#define SS_SENSOR_NO_NAME 0xFFFF
+#define SS_SENSOR_INDEX_SIZE 128 // power of two, at least twice SS_MAX_SENSORS
+#define SS_SENSOR_INDEX_EMPTY 0xFF
+
+enum SS_SENSOR_STATE {
+    SS_SENSOR_STATE_UNKNOWN = 0,
+    SS_SENSOR_STATE_CLEAR,
+    SS_SENSOR_STATE_TRIGGERED
+};
+
+struct SS3Sensor {
+    uint32_t serial;        // hex serial as a number
+    uint8_t type;           // SimpliSafe sensorType
+    uint8_t state;          // SS_SENSOR_STATE, triggered for SS_SENSOR_TRIGGER_HOLD after a trigger event
+    uint16_t nameId;        // offset into the table's name pool
+    uint16_t lastCid;       // last event seen for this sensor, 0 for none
+    uint32_t lastEventTime; // unix seconds
+};
+
+// Fixed-size sensor inventory with O(1) lookup by serial. Names live in one
+// shared pool so each entry stays 16 bytes.
+class SS3SensorTable {
+    private:
+        SS3Sensor sensors[SS_MAX_SENSORS];
+        uint8_t index[SS_SENSOR_INDEX_SIZE];
+        char names[SS_SENSOR_NAME_POOL];
+        size_t count = 0;
+        size_t namesUsed = 0;
+
+        size_t slot(uint32_t serial);
+        uint16_t addName(const char *name);
+
+    public:
+        SS3SensorTable();
+        void clear();
+        SS3Sensor *find(uint32_t serial);
+        SS3Sensor *upsert(uint32_t serial, uint8_t type, const char *name);
+        bool patch(uint32_t serial, uint8_t type, uint16_t cid, uint32_t timestamp, const char *name);
+        void settle(SS3Sensor &sensor, uint32_t now);
+        const char *getName(const SS3Sensor &sensor);
+        size_t size();
+        const SS3Sensor &at(size_t x);
+
+        static uint32_t parseSerial(const char *serial);
+        static bool isTriggerCid(uint16_t cid);
+};
+
+#endif
@@ -0,0 +1,354 @@
+#include "Session.h"
+#include "SimpliSafe3.h"
+#include "ConnectionPool.h"
+#include "FrameParser.h"
+#include "Lock.h"
+#include "Memory.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include "common.h"
+#include <ArduinoJson.h>
+#include <time.h>
+
+SS3Session *SS3Session::sessions[SS_MAX_ACCOUNTS] = {};
+SemaphoreHandle_t SS3Session::registryLock = nullptr;
+
+//
+// Private Member Functions
+//
+
+SS3Session::SS3Session(const String &accountName) : account(accountName), auth(accountName.c_str()) {
+    SS_LOG_LINE("Making session for account \"%s\".", account.c_str());
+    socketLock = xSemaphoreCreateRecursiveMutex();
+}
+
+size_t SS3Session::collectJoins(String *uids) {
+    // locations on one account normally share a user, so this is usually one uid
+    size_t count = 0;
+    for (int x = 0; x < SS_MAX_LOCATIONS; x++) {
+        SimpliSafe3 *ss = listeners[x];
+        if (!ss) continue;
+
+        SS3Lock stateGuard(ss->stateLock);
+        if (ss->userId.length() == 0) continue;
+
+        String uid = "uid:" + ss->userId;
+        bool seen = false;
+        for (size_t y = 0; y < count && !seen; y++) seen = uids[y].equals(uid);
+        if (!seen) uids[count++] = uid;
+    }
+
+    return count;
+}
+
+bool SS3Session::isDiscovering() {
+    for (int x = 0; x < SS_MAX_LOCATIONS; x++) {
+        if (listeners[x] && listeners[x]->discovering) return true;
+    }
+
+    return false;
+}
+
+void SS3Session::buildIdentify(JsonDocument &ident, const String *uids, size_t count, bool syncClock) {
+    struct tm timeInfo;
+    time_t now;
+    char isoDate[20];
+    if (syncClock) configTime(SS_TIME_GMT_OFFSET, SS_DST_OFFSET, SS_NTP_SERVER);
+    getLocalTime(&timeInfo, syncClock ? 5000 : 0);
+    time(&now);
+    sprintf(
+        isoDate,
+        "%04i-%02i-%02iT%02i:%02i:%02i",
+        timeInfo.tm_year + 1900,
+        timeInfo.tm_mon + 1,
+        timeInfo.tm_mday,
+        timeInfo.tm_hour,
+        timeInfo.tm_min,
+        timeInfo.tm_sec
+    );
+
+    ident["datacontenttype"] = "application/json";
+    ident["type"] = "com.simplisafe.connection.identify";
+    ident["time"] = isoDate; // "YYYY-MM-DDTHH:MM:SS";
+    ident["id"] = "ts:" + String(now);
+    ident["specversion"] = "1.0";
+    ident["source"] = "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/98.0.4758.102 Safari/537.36 Edg/98.0.1108.56",
+    ident["data"]["auth"]["schema"] = "bearer";
+    ident["data"]["auth"]["token"] = auth.getAccessToken();
+    for (size_t x = 0; x < count; x++) ident["data"]["join"][x] = uids[x];
+}
+
+void SS3Session::sendIdentify(SimpliSafe3 *target) {
+    SS3Lock socketGuard(socketLock);
+    if (!socket.isConnected()) {
+        // a replayed or injected hello, the real one comes once the socket connects
+        SS_DETAIL_LINE("WebSocket not connected, not sending identify.");
+        if (!auth.hasFixtures()) return;
+
+        // against fixtures the identify is still built, so soak runs cover the handshake
+        String uids[SS_MAX_LOCATIONS];
+        size_t count = 0;
+        if (target) {
+            SS3Lock stateGuard(target->stateLock);
+            if (target->userId.length() != 0) uids[count++] = "uid:" + target->userId;
+        } else count = collectJoins(uids);
+
+        SS3PooledDocument pooled(SS_PARSE_SLOT_IDENTIFY);
+        String identPayload;
+        buildIdentify(pooled.get(), uids, count, false);
+        serializeJson(pooled.get(), identPayload);
+        SS_DETAIL_LINE("Built identify: %s", identPayload.c_str());
+        return;
+    }
+
+    size_t count = collectJoins(joined);
+    if (count == 0) {
+        joinedCount = 0;
+        identifyPending = true; // discovery still running, poll() sends it later
+        return;
+    }
+    joinedCount = count;
+    identifyPending = false;
+    rejoinCheck = false;
+
+    SS3PooledDocument pooled(SS_PARSE_SLOT_IDENTIFY);
+    JsonDocument &ident = pooled.get();
+    String identPayload;
+    buildIdentify(ident, joined, joinedCount, true);
+    serializeJson(ident, identPayload);
+
+    if (!socket.sendTXT(identPayload)) {
+        SS_ERROR_LINE("Could not send identify message to websocket. %s", identPayload.c_str());
+    }
+    SS_DETAIL_LINE("Sent:");
+    #if SS_DEBUG >= SS_DEBUG_LEVEL_ALL
+        serializeJsonPretty(ident, Serial);
+        Serial.println("");
+    #endif
+}
+
+void SS3Session::onSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
+    switch(type) {
+        case WStype_DISCONNECTED:
+            SS_DETAIL_LINE("Websocket Disconnected.");
+            for (int x = 0; x < SS_MAX_LOCATIONS; x++) {
+                if (listeners[x]) listeners[x]->dispatch(SS_CALLBACK_DISCONNECT);
+            }
+            break;
+        case WStype_CONNECTED:
+            SS_DETAIL_LINE("Websocket connected to url: %s",  payload);
+            break;
+        case WStype_TEXT:
+            handleFrame(payload, length);
+            break;
+        case WStype_BIN: {
+                SS_DETAIL_LINE("Websocket got binary length: %u", length);
+                // hexdump(payload, length);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+//
+// Public Member Functions
+//
+
+SS3Session *SS3Session::acquire(const char *accountName) {
+    // first call happens while global SimpliSafe3 objects are constructed, before any tasks run
+    if (!registryLock) registryLock = xSemaphoreCreateMutex();
+    xSemaphoreTake(registryLock, portMAX_DELAY);
+    SS3ConnectionPool::begin();
+    SS3Memory::begin();
+
+    String name = accountName ? accountName : "";
+    if (name.length() > SS_ACCOUNT_NAME_MAX) {
+        SS_ERROR_LINE("Account name %s is too long, truncating to %i characters.", name.c_str(), SS_ACCOUNT_NAME_MAX);
+        name = name.substring(0, SS_ACCOUNT_NAME_MAX);
+    }
+
+    SS3Session *session = nullptr;
+    int freeSlot = -1;
+    for (int x = 0; x < SS_MAX_ACCOUNTS; x++) {
+        if (sessions[x] && sessions[x]->account.equals(name)) session = sessions[x];
+        else if (!sessions[x] && freeSlot < 0) freeSlot = x;
+    }
+
+    if (!session) {
+        session = new SS3Session(name);
+        if (freeSlot >= 0) sessions[freeSlot] = session;
+        else SS_ERROR_LINE("More than %i accounts, account \"%s\" won't be shared.", SS_MAX_ACCOUNTS, name.c_str());
+    }
+
+    session->refCount++;
+    xSemaphoreGive(registryLock);
+    return session;
+}
+
+void SS3Session::release(SS3Session *session) {
+    xSemaphoreTake(registryLock, portMAX_DELAY);
+    if (--session->refCount > 0) {
+        xSemaphoreGive(registryLock);
+        return;
+    }
+
+    SS_LOG_LINE("Closing session for account \"%s\".", session->account.c_str());
+    for (int x = 0; x < SS_MAX_ACCOUNTS; x++) {
+        if (sessions[x] == session) sessions[x] = nullptr;
+    }
+    xSemaphoreGive(registryLock);
+
+    if (session->socketStarted) session->socket.disconnect();
+    vSemaphoreDelete(session->socketLock);
+    delete session;
+}
+
+const String &SS3Session::getAccount() {
+    return account;
+}
+
+SemaphoreHandle_t SS3Session::getSocketLock() {
+    return socketLock;
+}
+
+bool SS3Session::isIdentifyPending() {
+    return identifyPending;
+}
+
+bool SS3Session::addListener(SimpliSafe3 *ss) {
+    SS3Lock socketGuard(socketLock);
+    int freeSlot = -1;
+    for (int x = 0; x < SS_MAX_LOCATIONS; x++) {
+        if (listeners[x] == ss) return true;
+        if (!listeners[x] && freeSlot < 0) freeSlot = x;
+    }
+
+    if (freeSlot < 0) {
+        SS_ERROR_LINE("Account \"%s\" already has %i listeners.", account.c_str(), SS_MAX_LOCATIONS);
+        return false;
+    }
+    listeners[freeSlot] = ss;
+
+    if (socketStarted) {
+        rejoinCheck = true; // its user may not be in the last identify
+        return true;
+    }
+
+    SS_LOG_LINE("Starting WebSocket for account \"%s\".", account.c_str());
+    socket.beginSslWithCA(SS_WEBSOCKET_URL, 443, "/", SS_API_CERT, "");
+    socket.onEvent([this](WStype_t type, uint8_t * payload, size_t length) {
+        onSocketEvent(type, payload, length);
+    });
+    socketStarted = true;
+    return true;
+}
+
+void SS3Session::removeListener(SimpliSafe3 *ss) {
+    SS3Lock socketGuard(socketLock);
+    bool any = false;
+    for (int x = 0; x < SS_MAX_LOCATIONS; x++) {
+        if (listeners[x] == ss) listeners[x] = nullptr;
+        any = any || listeners[x];
+    }
+
+    if (!any && socketStarted) {
+        SS_LOG_LINE("No listeners left, closing WebSocket.");
+        socket.disconnect();
+        socketStarted = false;
+        joinedCount = 0;
+    }
+}
+
+void SS3Session::poll() {
+    SS3Lock socketGuard(socketLock);
+    if (!socketStarted) return;
+
+    // a reconnect is a TLS handshake, hold off until there's room for one
+    if (!socket.isConnected() && !SS3Memory::allows(SS_HEAP_TLS_COST, SS_HEAP_TLS_BLOCK, "WebSocket connect")) return;
+
+    socket.loop();
+    if (isDiscovering()) return;
+
+    if (identifyPending) {
+        sendIdentify();
+    } else if (rejoinCheck) {
+        // a listener added after identify, reconnect so the next hello joins its user too
+        rejoinCheck = false;
+        String uids[SS_MAX_LOCATIONS];
+        size_t count = collectJoins(uids);
+        for (size_t x = 0; x < count; x++) {
+            bool found = false;
+            for (size_t y = 0; y < joinedCount && !found; y++) found = joined[y].equals(uids[x]);
+            if (!found && joinedCount > 0) {
+                SS_LOG_LINE("Rejoining WebSocket for %s.", uids[x].c_str());
+                socket.disconnect();
+                break;
+            }
+        }
+    }
+}
+
+void SS3Session::handleFrame(uint8_t *payload, size_t length, SimpliSafe3 *target) {
+    SS3Lock socketGuard(socketLock);
+    SS_PROFILE_SCOPE(SS_PROFILE_EVENT_DISPATCH);
+    if (SS3Trace::isRecording()) SS3Trace::recordFrame(payload, length); // before it's parsed in place
+    SS_DETAIL_LINE("Websocket got text: %s", payload);
+    SS3PooledDocument pooled(SS_PARSE_SLOT_FRAME);
+    JsonDocument &res = pooled.get();
+    SS_PROFILE_PARSE_BEGIN();
+    const char *reason = "";
+    int frame = SS3FrameParser::parse(payload, length, res, &reason);
+    SS_PROFILE_PARSE_END(length, res.memoryUsage());
+    if (frame == SS_FRAME_INVALID) {
+        SS_ERROR_LINE("Dropped websocket frame of %u bytes: %s", length, reason);
+        return;
+    }
+
+    // listen for hello, then send identify
+    if (frame == SS_FRAME_HELLO) {
+        SS_DETAIL_LINE("SimpliSafe says hello.");
+        sendIdentify(target);
+    }
+
+    // listen for registered
+    if (frame == SS_FRAME_REGISTERED) SS_LOG_LINE("Websocket registered.");
+
+    // listen for subscribed
+    if (frame == SS_FRAME_SUBSCRIBED) {
+        SS_DETAIL_LINE("Websocket subscribed.");
+        for (int x = 0; x < SS_MAX_LOCATIONS; x++) {
+            SimpliSafe3 *ss = target ? target : listeners[x];
+            if (ss) ss->handleSubscribed();
+            if (target) break;
+        }
+    }
+
+    // listen for events, routed to the location they came from
+    if (frame == SS_FRAME_EVENT) {
+        SS_DETAIL_LINE("Event %i triggered, %s", res["data"]["eventCid"].as<int>(), res["data"]["messageSubject"].as<const char *>());
+        JsonObject data = res["data"];
+        if (target) {
+            SS3Lock stateGuard(target->stateLock);
+            target->handleEvent(data);
+            return;
+        }
+
+        // locations that haven't discovered their sid yet only get events nobody else claims
+        String sid = data["sid"].isNull() ? String() : data["sid"].as<String>();
+        bool claimed = false;
+        for (int pass = 0; pass < 2 && !claimed; pass++) {
+            for (int x = 0; x < SS_MAX_LOCATIONS; x++) {
+                SimpliSafe3 *ss = listeners[x];
+                if (!ss) continue;
+
+                SS3Lock stateGuard(ss->stateLock);
+                bool matches = pass == 0 ? sid.length() != 0 && ss->subId.equals(sid) : ss->subId.length() == 0 || sid.length() == 0;
+                if (!matches) continue;
+
+                ss->handleEvent(data);
+                claimed = true;
+            }
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef __SS3SESSION_H__
+#define __SS3SESSION_H__
+
+#include <Arduino.h>
+#include <WebSocketsClient.h>
+#include "AuthManager.h"
+#include "common.h"
+
+class SimpliSafe3;
+
+// Everything an account needs once however many SimpliSafe3 instances (one
+// per location) use it: credentials, tokens and the event socket. Sessions
+// are reference counted and shared by account name through acquire().
+class SS3Session {
+    private:
+        static SS3Session *sessions[SS_MAX_ACCOUNTS];
+        static SemaphoreHandle_t registryLock;
+
+        String account;
+        int refCount = 0;
+        SimpliSafe3 *listeners[SS_MAX_LOCATIONS] = {};
+        String joined[SS_MAX_LOCATIONS]; // uids sent with the last identify
+        size_t joinedCount = 0;
+        WebSocketsClient socket;
+        SemaphoreHandle_t socketLock;
+        bool socketStarted = false;
+        volatile bool identifyPending = false;
+        volatile bool rejoinCheck = false;
+
+        SS3Session(const String &accountName);
+        size_t collectJoins(String *uids);
+        bool isDiscovering();
+        void buildIdentify(JsonDocument &ident, const String *uids, size_t count, bool syncClock);
+        void sendIdentify(SimpliSafe3 *target = nullptr);
+        void onSocketEvent(WStype_t type, uint8_t *payload, size_t length);
+
+    public:
+        SS3AuthManager auth;
+
+        static SS3Session *acquire(const char *accountName);
+        static void release(SS3Session *session);
+        const String &getAccount();
+        SemaphoreHandle_t getSocketLock();
+        bool isIdentifyPending();
+        bool addListener(SimpliSafe3 *ss);
+        void removeListener(SimpliSafe3 *ss);
+        void poll();
+        void handleFrame(uint8_t *payload, size_t length, SimpliSafe3 *target = nullptr); // payload is parsed in place
+};
+
+#endif
@@ -1,8 +1,11 @@
 #include "SimpliSafe3.h"
 #include "common.h"
+#include "Profiler.h"
+#include "Trace.h"
 #include <ArduinoJson.h>
 #include "AuthManager.h"
-#include <WebSocketsClient.h>
+#include "Lock.h"
+#include "Memory.h"
 #include <time.h>
 
 const char* SS_GETSTATE_VALUES[7] = {
@@ -25,20 +28,291 @@ const char* SS_LOCKSTATE_VALUES[2] = {
     "lock"
 };
 
+// eventCids that carry the alarm or lock state, { cid, state }
+const int SS_ALARM_STATE_CIDS[][2] = {
+    { 1110, SS_GETSTATE_ALARM },
+    { 1120, SS_GETSTATE_ALARM },
+    { 1132, SS_GETSTATE_ALARM },
+    { 1134, SS_GETSTATE_ALARM },
+    { 1154, SS_GETSTATE_ALARM },
+    { 1159, SS_GETSTATE_ALARM },
+    { 1162, SS_GETSTATE_ALARM },
+    { 1400, SS_GETSTATE_OFF },
+    { 1406, SS_GETSTATE_OFF },
+    { 1407, SS_GETSTATE_OFF },
+    { 3401, SS_GETSTATE_AWAY },
+    { 3407, SS_GETSTATE_AWAY },
+    { 3481, SS_GETSTATE_AWAY },
+    { 3487, SS_GETSTATE_AWAY },
+    { 3441, SS_GETSTATE_HOME },
+    { 3491, SS_GETSTATE_HOME },
+    { 9401, SS_GETSTATE_AWAY_COUNT },
+    { 9407, SS_GETSTATE_AWAY_COUNT },
+    { 9441, SS_GETSTATE_HOME_COUNT }
+};
+const int SS_LOCK_STATE_CIDS[][2] = {
+    { 9700, SS_GETLOCKSTATE_UNLOCKED },
+    { 9701, SS_GETLOCKSTATE_LOCKED }
+};
+
 //
 // Private Member Functions
 //
 
+void SimpliSafe3::netTaskLoop(void *param) {
+    SimpliSafe3 *ss = (SimpliSafe3 *)param;
+    SS_LOG_LINE("Network task running on core %i.", xPortGetCoreID());
+    for (;;) {
+        ss->poll();
+
+        // api calls from other tasks run here, waiting for one doubles as the poll interval
+        SS3NetCommand *command;
+        if (xQueueReceive(ss->commandQueue, &command, pdMS_TO_TICKS(SS_NET_TASK_INTERVAL)) == pdTRUE) {
+            ss->runCommand(*command);
+            xSemaphoreGive(ss->commandDone);
+        }
+    }
+}
+
+void SimpliSafe3::discoveryTaskLoop(void *param) {
+    SimpliSafe3 *ss = (SimpliSafe3 *)param;
+    SS_LOG_LINE("Discovering user and subscription.");
+
+    // no stateLock across the requests, so loop() keeps polling the socket while they run
+    StaticJsonDocument<256> sub = ss->getSubscription();
+    if (sub.size() > 0) {
+        // carries the alarm state, so readers have it before anyone asks
+        int alarmState = ss->parseAlarmState(sub);
+        if (alarmState != SS_GETSTATE_UNKNOWN) ss->publishState(alarmState, SS_STATE_KEEP);
+
+        SS3Lock stateGuard(ss->stateLock);
+        ss->markFirstState();
+    }
+
+    ss->discoveryStackFree = uxTaskGetStackHighWaterMark(nullptr); // one-shot, so measure before it's gone
+    ss->discovering = false;
+    vTaskDelete(nullptr);
+}
+
+bool SimpliSafe3::startDiscovery() {
+    if (discovering) return true;
+
+    discovering = true;
+    // its TLS requests stay on the protocol core with the network task
+    if (xTaskCreatePinnedToCore(discoveryTaskLoop, "SimpliSafe3Discovery", SS_DISCOVERY_TASK_STACK, this, SS_NET_TASK_PRIORITY, nullptr, netCore) != pdPASS) {
+        SS_ERROR_LINE("Error creating discovery task, discovering inline.");
+        discovering = false;
+        return getUserID().length() != 0;
+    }
+
+    return true;
+}
+
+void SimpliSafe3::markFirstState() {
+    if (startup.firstStateMS == 0) {
+        startup.firstStateMS = millis();
+        SS_LOG_LINE("First state after %lums.", startup.firstStateMS);
+    }
+}
+
+void SimpliSafe3::handleSubscribed() {
+    SS3Lock stateGuard(stateLock);
+    if (startup.subscribedMS == 0) {
+        startup.subscribedMS = millis();
+        SS_LOG_LINE("Subscribed after %lums.", startup.subscribedMS);
+    }
+    dispatch(SS_CALLBACK_CONNECT);
+}
+
+void SimpliSafe3::publishState(int alarmState, int lockState, uint16_t cid) {
+    SS3StateChange change;
+    if (!states.publish(alarmState, lockState, cid, change.oldState, change.newState)) return;
+
+    // subscribers always run from loop(), never on the task that published, which may be holding locks
+    if (states.hasSubscribers() && xQueueSend(stateQueue, &change, 0) != pdTRUE) {
+        SS_ERROR_LINE("State queue full, dropped change %lu.", (unsigned long)change.newState.version);
+    }
+}
+
+int SimpliSafe3::parseAlarmState(const JsonDocument &sub) {
+    if (sub["location"] && sub["location"]["system"]) { 
+        if (sub["location"]["system"]["isAlarming"].as<bool>()) return SS_GETSTATE_ALARM;
+
+        const char *resState = sub["location"]["system"]["alarmState"].as<const char*>();                
+        for (int x = 0; resState && x < sizeof(SS_GETSTATE_VALUES) / sizeof(SS_GETSTATE_VALUES[0]); x++) {
+            if (strcmp(resState, SS_GETSTATE_VALUES[x]) == 0) {
+                SS_DETAIL_LINE("Found state at index %i.", x);
+                return x;
+            }
+        }
+    }
+
+    SS_ERROR_LINE("Subscription doesn't have location or system.");
+    return SS_GETSTATE_UNKNOWN;
+}
+
+void SimpliSafe3::handleEvent(JsonObject data) {
+    uint32_t serial = SS3SensorTable::parseSerial(data["sensorSerial"]);
+    uint32_t timestamp = data["eventTimestamp"] | (uint32_t)time(nullptr);
+
+    if (journal) {
+        journal->append(
+            data["eventCid"].as<int>(),
+            timestamp,
+            data["sid"].as<uint32_t>(),
+            serial,
+            data["sensorType"].as<int>()
+        );
+    }
+
+    if (sensors && serial != 0) {
+        sensors->patch(serial, data["sensorType"].as<int>(), data["eventCid"].as<int>(), timestamp, data["sensorName"]);
+    }
+
+    int cid = data["eventCid"];
+    for (int x = 0; x < sizeof(SS_ALARM_STATE_CIDS) / sizeof(SS_ALARM_STATE_CIDS[0]); x++) {
+        if (SS_ALARM_STATE_CIDS[x][0] == cid) publishState(SS_ALARM_STATE_CIDS[x][1], SS_STATE_KEEP, cid);
+    }
+    for (int x = 0; x < sizeof(SS_LOCK_STATE_CIDS) / sizeof(SS_LOCK_STATE_CIDS[0]); x++) {
+        if (SS_LOCK_STATE_CIDS[x][0] == cid) publishState(SS_STATE_KEEP, SS_LOCK_STATE_CIDS[x][1], cid);
+    }
+
+    dispatch(SS_CALLBACK_EVENT, cid, serial);
+}
+
+void SimpliSafe3::poll() {
+    // poll the account's WebSocket, without stateLock so discovery requests don't hold up the TLS connect
+    session->poll();
+
+    SS3Lock stateGuard(stateLock);
+
+    // refresh auth token
+    const unsigned long now = millis();
+    const unsigned long diff = max(now, lastAuthCheck) - min(now, lastAuthCheck);
+    if (diff >= SS_AUTH_CHECK_INTERVAL) {
+        if (!authManager->isAuthorized()) {
+            if (SS3Trace::isRecording()) SS3Trace::recordOp(SS_TRACE_OP_AUTHORIZE);
+            if (!authManager->authorizeIfNeeded(inSerial, inBaud)) {
+                SS_ERROR_LINE("Error refreshing authorization token.");
+            }
+        }
+
+        // discovery failed and the socket is waiting on it, try again
+        if (session->isIdentifyPending() && !discovering && userId.length() == 0) startDiscovery();
+
+        lastAuthCheck = now;
+    }
+
+    if (journal) journal->loop();
+
+    // tell the app when the heap ran short so it can shed load
+    if (SS3Memory::getLowMemoryCount() != lowMemorySeen) {
+        lowMemorySeen = SS3Memory::getLowMemoryCount();
+        dispatch(SS_CALLBACK_LOW_MEMORY, SS3Memory::getLowFree(), SS3Memory::getLowBlock());
+    }
+}
+
+bool SimpliSafe3::runOnNetworkTask(int type, int arg, int &result) {
+    if (!netTask || xTaskGetCurrentTaskHandle() == netTask) return false;
+
+    SS3Lock commandGuard(commandLock);
+    if (!netTask) return false; // stopped while we waited our turn
+
+    SS3NetCommand command = { (uint8_t)type, arg, 0 };
+    SS3NetCommand *pending = &command;
+    xQueueSend(commandQueue, &pending, portMAX_DELAY);
+    xSemaphoreTake(commandDone, portMAX_DELAY);
+    result = command.result;
+    return true;
+}
+
+void SimpliSafe3::runCommand(SS3NetCommand &command) {
+    switch (command.type) {
+        case SS_NET_COMMAND_GET_ALARM_STATE: command.result = getAlarmState(); break;
+        case SS_NET_COMMAND_SET_ALARM_STATE: command.result = setAlarmState(command.arg); break;
+        case SS_NET_COMMAND_GET_LOCK_STATE: command.result = getLockState(); break;
+        case SS_NET_COMMAND_SET_LOCK_STATE: command.result = setLockState(command.arg); break;
+        case SS_NET_COMMAND_REFRESH_SENSORS: command.result = refreshSensors(); break;
+        case SS_NET_COMMAND_REFRESH_AUTHORIZATION: command.result = refreshAuthorization(); break;
+    }
+}
+
+void SimpliSafe3::deliver(const SS3CallbackMessage &message) {
+    switch (message.type) {
+        case SS_CALLBACK_EVENT: 
+            if (onEvent) onEvent(message.eventId);
+            if (onSensorEvent && message.serial != 0) {
+                SS3Sensor sensor;
+                char name[48];
+                if (getSensor(message.serial, sensor, name, sizeof(name))) onSensorEvent(message.eventId, sensor, name);
+            }
+            break;
+        case SS_CALLBACK_CONNECT: if (onConnect) onConnect(); break;
+        case SS_CALLBACK_DISCONNECT: if (onDisconnect) onDisconnect(); break;
+        case SS_CALLBACK_LOW_MEMORY: if (onLowMemory) onLowMemory(message.eventId, message.serial); break;
+    }
+}
+
+void SimpliSafe3::drainStates() {
+    SS3StateChange change;
+    while (xQueueReceive(stateQueue, &change, 0) == pdTRUE) states.notify(change.oldState, change.newState);
+}
+
+void SimpliSafe3::deleteNetQueues() {
+    if (commandQueue) vQueueDelete(commandQueue);
+    if (commandDone) vSemaphoreDelete(commandDone);
+    commandQueue = nullptr;
+    commandDone = nullptr;
+}
+
+int SimpliSafe3::request(
+    const char *url,
+    JsonDocument &doc,
+    bool auth,
+    bool post,
+    const char *payload,
+    const SS3Header *headers,
+    size_t headerCount,
+    const JsonDocument *filter,
+    const DeserializationOption::NestingLimit &nestingLimit
+) {
+    // kept so callers of the int and bool api can tell a fast fail from a failed request
+    int res = authManager->request(url, doc, auth, post, payload, headers, headerCount, filter, nestingLimit);
+    lastRequestResult = res;
+    return res;
+}
+
+void SimpliSafe3::drainCallbacks() {
+    SS3CallbackMessage message;
+    while (xQueueReceive(callbackQueue, &message, 0) == pdTRUE) deliver(message);
+}
+
+void SimpliSafe3::dispatch(int type, int eventId, uint32_t serial) {
+    SS3CallbackMessage message = { (uint8_t)type, eventId, serial };
+    if (callbackQueue) {
+        // hand off to whichever task calls our loop(), the socket may be polled by another instance's network task
+        if (xQueueSend(callbackQueue, &message, 0) != pdTRUE) SS_ERROR_LINE("Callback queue full, dropped callback %i.", type);
+        return;
+    }
+
+    deliver(message);
+}
+
 String SimpliSafe3::getUserID() {
     SS_LOG_LINE("Getting user ID.");
-    if (userId.length() != 0) {
-        SS_LOG_LINE("User ID %s already exists.", userId.c_str());
-        return userId;
+    {
+        // discovery calls this without stateLock, so only hold it around userId
+        SS3Lock stateGuard(stateLock);
+        if (userId.length() != 0) {
+            SS_LOG_LINE("User ID %s already exists.", userId.c_str());
+            return userId;
+        }
     }
 
     StaticJsonDocument<64> data; 
-    int res = authManager->request(String(SS3API) + "/api/authCheck", data);
+    int res = request(SS3API "/api/authCheck", data);
     if (res >= 200 && res <= 299) {
+        SS3Lock stateGuard(stateLock);
         userId = data["userId"].as<String>();
         SS_LOG_LINE("Got user ID %s.", userId.c_str());
         return userId;
@@ -49,108 +323,25 @@ String SimpliSafe3::getUserID() {
 }
 
 bool SimpliSafe3::startListeningToEvents(void (*eventCallback)(int eventId), void (*connectCallback)(), void (*disconnectCallback)()) {
-    SS_LOG_LINE("Starting WebSocket.");
-    String userIdLocal;
-    if (userId.length() == 0) {
-        userIdLocal = getUserID();
-        if (userIdLocal.length() == 0) {
+    SS_LOG_LINE("Listening to events for location %i.", location);
+    {
+        SS3Lock stateGuard(stateLock);
+        onEvent = eventCallback;
+        onConnect = connectCallback;
+        onDisconnect = disconnectCallback;
+
+        // connect while the user ID is fetched, identify waits for it
+        if (userId.length() == 0 && !startDiscovery()) {
             SS_ERROR_LINE("Cannot start WebSocket without userId.");
             return false;
         }
     }
-    
-    socket.beginSslWithCA(SS_WEBSOCKET_URL, 443, "/", SS_API_CERT, "");
-    socket.onEvent([this, userIdLocal, eventCallback, connectCallback, disconnectCallback](WStype_t type, uint8_t * payload, size_t length) {
-        switch(type) {
-        case WStype_DISCONNECTED:
-            SS_DETAIL_LINE("Websocket Disconnected.");
-            if (disconnectCallback) disconnectCallback();
-            break;
-        case WStype_CONNECTED:
-            SS_DETAIL_LINE("Websocket connected to url: %s",  payload);
-            break;
-        case WStype_TEXT: {
-                SS_DETAIL_LINE("Websocket got text: %s", payload);
-                DynamicJsonDocument res(2048);
-                DeserializationError err = deserializeJson(res, payload);
-                if (err) SS_ERROR_LINE("Error deserializing websocket response: %s", err.c_str());
-
-                // listen for hello, then send identify
-                String type = res["type"];
-                if (type.equals("com.simplisafe.service.hello")) {
-                    SS_DETAIL_LINE("SimpliSafe says hello.");
-
-                    struct tm timeInfo;
-                    time_t now;
-                    char isoDate[20];
-                    configTime(SS_TIME_GMT_OFFSET, SS_DST_OFFSET, SS_NTP_SERVER);
-                    getLocalTime(&timeInfo);
-                    time(&now);
-                    sprintf(
-                        isoDate,
-                        "%04i-%02i-%02iT%02i:%02i:%02i",
-                        timeInfo.tm_year + 1900,
-                        timeInfo.tm_mon + 1,
-                        timeInfo.tm_mday,
-                        timeInfo.tm_hour,
-                        timeInfo.tm_min,
-                        timeInfo.tm_sec
-                    );
-
-                    DynamicJsonDocument ident(2048);
-                    String identPayload;
-                    ident["datacontenttype"] = "application/json";
-                    ident["type"] = "com.simplisafe.connection.identify";
-                    ident["time"] = isoDate; // "YYYY-MM-DDTHH:MM:SS";
-                    ident["id"] = "ts:" + String(now);
-                    ident["specversion"] = "1.0";
-                    ident["source"] = "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/98.0.4758.102 Safari/537.36 Edg/98.0.1108.56",
-                    ident["data"]["auth"]["schema"] = "bearer";
-                    ident["data"]["auth"]["token"] = authManager->accessToken;
-                    ident["data"]["join"][0] = "uid:" + userIdLocal;
-                    serializeJson(ident, identPayload);
-
-                    if (!socket.sendTXT(identPayload)) {
-                        SS_ERROR_LINE("Could not send identify message to websocket. %s", identPayload.c_str());
-                    }
-                    SS_DETAIL_LINE("Sent:");
-                    #if SS_DEBUG >= SS_DEBUG_LEVEL_ALL
-                        serializeJsonPretty(ident, Serial);
-                        inSerial->println("");
-                    #endif
-                }
-
-                // listen for registered
-                if (type.equals("com.simplisafe.service.registered")) SS_LOG_LINE("Websocket registered.");
-                
-                // listen for subscribed
-                if (type.equals("com.simplisafe.namespace.subscribed")) {
-                    SS_DETAIL_LINE("Websocket subscribed.");
-                    if (connectCallback) connectCallback();
-                }
-                
-                // listen for events
-                if (type.equals("com.simplisafe.event.standard")) {
-                    SS_DETAIL_LINE("Event %i triggered, %s", res["data"]["eventCid"].as<int>(), res["data"]["messageSubject"].as<const char *>());
-                    if (eventCallback) eventCallback(res["data"]["eventCid"]);
-                }
-            }
-            break;
-        case WStype_BIN: {
-                SS_DETAIL_LINE("Websocket got binary length: %u", length);
-                // hexdump(payload, length);
-            }
-            break;
-		case WStype_ERROR:			
-		case WStype_FRAGMENT_TEXT_START:
-		case WStype_FRAGMENT_BIN_START:
-		case WStype_FRAGMENT:
-		case WStype_FRAGMENT_FIN:
-			break;
-    }
-    });
 
-    return true;
+    return session->addListener(this);
+}
+
+void SimpliSafe3::handleFrame(uint8_t *payload, size_t length) {
+    session->handleFrame(payload, length, this);
 }
 
 StaticJsonDocument<256> SimpliSafe3::getSubscription() {
@@ -166,24 +357,27 @@ StaticJsonDocument<256> SimpliSafe3::getSubscription() {
     filter["subscriptions"][0]["location"]["system"]["alarmState"] = true;
     filter["subscriptions"][0]["location"]["system"]["isAlarming"] = true;
 
-    StaticJsonDocument<256> sub;
-    int res = authManager->request(
-        String(SS3API) + "/users/"+userIdStr+"/subscriptions?activeOnly=true", 
+    DynamicJsonDocument sub(128 + 160 * (location + 1)); // room for every location up to ours
+    SS3Url url(SS3API "/users/%s/subscriptions?activeOnly=true", userIdStr.c_str());
+    int res = request(
+        url.c_str(),
         sub, 
         true,
         false,
         "",
-        StaticJsonDocument<0>(),
-        filter,
+        nullptr,
+        0,
+        &filter,
         DeserializationOption::NestingLimit(11)
     );
 
-    if (res >= 200 && res <= 299) {
+    if (res >= 200 && res <= 299 && !sub["subscriptions"][location].isNull()) {
         // TODO: Handle other situations
-        subId = String(sub["subscriptions"][0]["sid"].as<int>());
-        SS_LOG_LINE("Got subscription ID %s.", subId.c_str());
+        SS3Lock stateGuard(stateLock);
+        subId = String(sub["subscriptions"][location]["sid"].as<int>());
+        SS_LOG_LINE("Got subscription ID %s for location %i.", subId.c_str(), location);
 
-        return sub["subscriptions"][0];
+        return sub["subscriptions"][location];
     }
 
     SS_ERROR_LINE("Error getting all subscriptions.");
@@ -203,14 +397,16 @@ StaticJsonDocument<192> SimpliSafe3::getLock() {
     filter[0]["status"]["lockJamState"] = true;
 
     StaticJsonDocument<192> data;
-    int res = authManager->request(
-        String(SS3API) + "/doorlock/" + subId, // url
+    SS3Url url(SS3API "/doorlock/%s", subId.c_str());
+    int res = request(
+        url.c_str(),                           // url
         data,                                  // size
         true,                                  // auth
         false,                                 // post
         "",                                    // payload
-        StaticJsonDocument<0>(),               // headers
-        filter
+        nullptr,                               // headers
+        0,                                     // header count
+        &filter
     );
 
     if (res >= 200 && res <= 299) {
@@ -227,45 +423,78 @@ StaticJsonDocument<192> SimpliSafe3::getLock() {
 // Public Member Functions
 //
 
-SimpliSafe3::SimpliSafe3() {
+SimpliSafe3::SimpliSafe3(const char *account, int location) : location(location) {
     SS_LOG_LINE("Making SimpliSafe3.");
-    authManager = new SS3AuthManager();
+    session = SS3Session::acquire(account);
+    authManager = &session->auth;
+    stateLock = xSemaphoreCreateRecursiveMutex();
+    commandLock = xSemaphoreCreateRecursiveMutex();
+    callbackQueue = xQueueCreate(SS_CALLBACK_QUEUE_LENGTH, sizeof(SS3CallbackMessage));
+    stateQueue = xQueueCreate(SS_STATE_QUEUE_LENGTH, sizeof(SS3StateChange));
+}
+
+SimpliSafe3::~SimpliSafe3() {
+    SS_LOG_LINE("Destroying SimpliSafe3.");
+    stopNetworkTask();
+    while (discovering) delay(10);
+    session->removeListener(this);
+
+    if (journal) journal->flush();
+    delete journal;
+    delete sensors;
+    SS3Session::release(session);
+    vSemaphoreDelete(stateLock);
+    vSemaphoreDelete(commandLock);
+    vQueueDelete(callbackQueue);
+    vQueueDelete(stateQueue);
 }
 
 bool SimpliSafe3::setup(bool forceReauth, HardwareSerial *hwSerial, unsigned long baud) {
     SS_LOG_LINE("Setting up SimpliSafe.");
+    SS3Lock stateGuard(stateLock);
     inSerial = hwSerial;
     inBaud = baud;
+    if (SS3Trace::isRecording()) SS3Trace::recordOp(SS_TRACE_OP_AUTHORIZE);
 
-    // get authorized for api calls
-    if (!authManager->authorize(forceReauth, inSerial, inBaud)) {
+    // the clock tells us whether the persisted token is still good
+    struct tm timeInfo;
+    configTime(SS_TIME_GMT_OFFSET, SS_DST_OFFSET, SS_NTP_SERVER);
+    getLocalTime(&timeInfo, SS_CLOCK_SYNC_WAIT);
+
+    // get authorized for api calls, skipping the refresh when we can
+    // reuse what another location on this account already authorized, or what was persisted
+    startup.reusedToken = !forceReauth && (authManager->isAuthorized() || authManager->restoreAuthToken());
+    if (!startup.reusedToken && !authManager->authorize(forceReauth, inSerial, inBaud)) {
         SS_ERROR_LINE("Failed to authorize with SimpliSafe.");
         return false;
     }
 
+    if (startup.authorizedMS == 0) {
+        startup.authorizedMS = millis();
+        SS_LOG_LINE("Authorized after %lums%s.", startup.authorizedMS, startup.reusedToken ? ", reused token" : "");
+    }
+
     return true;
 }
 
 void SimpliSafe3::loop() {
-    // poll for WebSocket
-    socket.loop();
+    appTask = xTaskGetCurrentTaskHandle();
 
-    // refresh auth token
-    const unsigned long now = millis();
-    const unsigned long diff = max(now, lastAuthCheck) - min(now, lastAuthCheck);
-    if (diff >= SS_AUTH_CHECK_INTERVAL) {
-        if (!authManager->isAuthorized()) {
-            if (!authManager->authorize(false, inSerial, inBaud)) {
-                SS_ERROR_LINE("Error refreshing authorization token.");
-            }
-        }
+    if (!netTask) poll(); // takes socketLock then stateLock itself, never one inside the other
 
-        lastAuthCheck = now;
-    }
+    // callbacks are always queued, so they run here on the app core whoever polled the socket
+    drainCallbacks();
+    drainStates();
 }
 
 int SimpliSafe3::getAlarmState() {
+    int result;
+    if (runOnNetworkTask(SS_NET_COMMAND_GET_ALARM_STATE, 0, result)) return result;
+
     SS_LOG_LINE("Getting alarm state.");
+    SS3Lock stateGuard(stateLock);
+    if (SS3Trace::isRecording()) SS3Trace::recordOp(SS_TRACE_OP_GET_ALARM_STATE);
+    SS_PROFILE_SCOPE(SS_PROFILE_GET_ALARM_STATE);
     DynamicJsonDocument sub = getSubscription();
 
     if (sub.size() == 0) {
@@ -273,34 +502,32 @@ int SimpliSafe3::getAlarmState() {
         return SS_GETSTATE_UNKNOWN;
     }
 
-    if (sub["location"] && sub["location"]["system"]) { 
-        if (sub["location"]["system"]["isAlarming"].as<bool>())
-            return SS_GETSTATE_ALARM;
-
-        const char *resState = sub["location"]["system"]["alarmState"].as<const char*>();                
-        for (int x = 0; x < sizeof(SS_GETSTATE_VALUES) / sizeof(SS_GETSTATE_VALUES[0]); x++) {
-            if (strcmp(resState, SS_GETSTATE_VALUES[x]) == 0) {
-                SS_DETAIL_LINE("Found state at index %i.", x);
-                SS_LOG_LINE("Got alarm state: %s", SS_GETSTATE_VALUES[x]);
-                return x;
-            }
-        }
+    int alarmState = parseAlarmState(sub);
+    if (alarmState != SS_GETSTATE_UNKNOWN) {
+        SS_LOG_LINE("Got alarm state: %s", SS_GETSTATE_VALUES[alarmState]);
+        publishState(alarmState, SS_STATE_KEEP);
+        markFirstState();
     }
-    
-    SS_ERROR_LINE("Subscription doesn't have location or system.");
-    return SS_GETSTATE_UNKNOWN;
+
+    return alarmState;
 }
 
 int SimpliSafe3::setAlarmState(int newState) {
+    int result;
+    if (runOnNetworkTask(SS_NET_COMMAND_SET_ALARM_STATE, newState, result)) return result;
+
     SS_LOG_LINE("Setting alarm state.");
+    SS3Lock stateGuard(stateLock);
+    if (SS3Trace::isRecording()) SS3Trace::recordOp(SS_TRACE_OP_SET_ALARM_STATE, newState);
 
     if (subId.length() == 0) {
         getSubscription();
     }
 
     StaticJsonDocument<96> data;
-    int res = authManager->request(
-        String(SS3API) + "/ss3/subscriptions/" + subId + "/state/" + SS_SETSTATE_VALUES[newState], // url
+    SS3Url url(SS3API "/ss3/subscriptions/%s/state/%s", subId.c_str(), SS_SETSTATE_VALUES[newState]);
+    int res = request(
+        url.c_str(), // url
         data, // size
         true, // auth
         true // post
@@ -312,6 +539,7 @@ int SimpliSafe3::setAlarmState(int newState) {
             if (strcmp(resState, SS_GETSTATE_VALUES[x]) == 0) {
                 SS_DETAIL_LINE("Found state at index %i.", x);
                 SS_LOG_LINE("Set alarm state to %s", SS_GETSTATE_VALUES[x]);
+                publishState(x, SS_STATE_KEEP);
                 return x;
             }
         }
@@ -322,7 +550,13 @@ int SimpliSafe3::setAlarmState(int newState) {
 }
 
 int SimpliSafe3::getLockState() {
+    int result;
+    if (runOnNetworkTask(SS_NET_COMMAND_GET_LOCK_STATE, 0, result)) return result;
+
     SS_LOG_LINE("Getting lock state.");
+    SS3Lock stateGuard(stateLock);
+    if (SS3Trace::isRecording()) SS3Trace::recordOp(SS_TRACE_OP_GET_LOCK_STATE);
+    SS_PROFILE_SCOPE(SS_PROFILE_GET_LOCK_STATE);
 
     if (subId.length() == 0) {
         getSubscription();
@@ -333,6 +567,8 @@ int SimpliSafe3::getLockState() {
     if (lock.size() > 0) {
         int resState = lock["status"]["lockState"].as<int>();
         SS_LOG_LINE("Got lock state: %s", SS_LOCKSTATE_VALUES[resState]);
+        publishState(SS_STATE_KEEP, resState);
+        markFirstState();
         return resState;
     }
 
@@ -341,7 +577,13 @@ int SimpliSafe3::getLockState() {
 }
 
 int SimpliSafe3::setLockState(int newState) {
+    int result;
+    if (runOnNetworkTask(SS_NET_COMMAND_SET_LOCK_STATE, newState, result)) return result;
+
     SS_LOG_LINE("Setting lock state.");
+    SS3Lock stateGuard(stateLock);
+    if (SS3Trace::isRecording()) SS3Trace::recordOp(SS_TRACE_OP_SET_LOCK_STATE, newState);
+    SS_PROFILE_SCOPE(SS_PROFILE_SET_LOCK_STATE);
 
     if (subId.length() == 0) {
         getSubscription();
@@ -351,30 +593,245 @@ int SimpliSafe3::setLockState(int newState) {
         getLock();
     }
 
-    StaticJsonDocument<96> headers;
-    headers[0]["name"] = "Content-Type";
-    headers[0]["value"] = "application/json";
+    const SS3Header headers[] = {
+        { "Content-Type", "application/json" }
+    };
 
     StaticJsonDocument<96> payloadDoc;
-    String payload;
+    char payload[32];
     payloadDoc["state"] = SS_LOCKSTATE_VALUES[newState];
-    serializeJson(payloadDoc, payload);
+    serializeJson(payloadDoc, payload, sizeof(payload));
 
     StaticJsonDocument<256> data;
-    int res = authManager->request(
-        String(SS3API) + "/doorlock/" + subId + "/" + lockId + "/state", // url
+    SS3Url url(SS3API "/doorlock/%s/%s/state", subId.c_str(), lockId.c_str());
+    int res = request(
+        url.c_str(), // url
         data,   // size
         true,   // auth
         true,   // post 
         payload,
-        headers
+        headers,
+        sizeof(headers) / sizeof(headers[0])
     );
 
     if (res >= 200 && res <= 299) {
         SS_LOG_LINE("Set lock state to %s", SS_LOCKSTATE_VALUES[newState]);
-        return newState; // api is async and doesn't tell us if it worked
+        return newState; // api is async and doesn't tell us if it worked, the 9700/9701 event publishes it
     }
 
     SS_ERROR_LINE("Error setting lock state.");
     return SS_GETLOCKSTATE_UNKNOWN;
+}
+
+const SS3BreakerMetrics &SimpliSafe3::getBreakerMetrics(int endpoint) {
+    return authManager->getBreakerMetrics(endpoint);
+}
+
+int SimpliSafe3::getLastRequestResult() {
+    return lastRequestResult;
+}
+
+void SimpliSafe3::setFixtures(const SS3Fixture *fixtureList, size_t count) {
+    authManager->setFixtures(fixtureList, count);
+}
+
+bool SimpliSafe3::startNetworkTask(int core) {
+    SS_LOG_LINE("Starting network task on core %i.", core);
+    netCore = core;
+    if (netTask) return true;
+
+    commandQueue = xQueueCreate(1, sizeof(SS3NetCommand *));
+    commandDone = xSemaphoreCreateBinary();
+    if (!commandQueue || !commandDone) {
+        SS_ERROR_LINE("Error creating network task queues.");
+        deleteNetQueues();
+        return false;
+    }
+
+    if (xTaskCreatePinnedToCore(netTaskLoop, "SimpliSafe3", SS_NET_TASK_STACK, this, SS_NET_TASK_PRIORITY, &netTask, core) != pdPASS) {
+        SS_ERROR_LINE("Error creating network task.");
+        deleteNetQueues();
+        netTask = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void SimpliSafe3::stopNetworkTask() {
+    SS_LOG_LINE("Stopping network task.");
+    if (!netTask) return;
+
+    {
+        // never kill the task while it holds a lock or runs a handed-off call
+        SS3Lock commandGuard(commandLock);
+        SS3Lock socketGuard(session->getSocketLock());
+        SS3Lock stateGuard(stateLock);
+        vTaskDelete(netTask);
+        netTask = nullptr;
+    }
+
+    drainCallbacks(); // deliver what was already queued
+    deleteNetQueues();
+}
+
+SS3StackReport SimpliSafe3::getStackHighWaterMarks() {
+    SS3StackReport report;
+    if (netTask) report.netTaskFree = uxTaskGetStackHighWaterMark(netTask);
+    if (appTask) report.appTaskFree = uxTaskGetStackHighWaterMark(appTask);
+    report.discoveryTaskFree = discoveryStackFree;
+    SS_LOG_LINE(
+        "Stack high-water marks: network %lu bytes, app %lu bytes, discovery %lu bytes.",
+        (unsigned long)report.netTaskFree,
+        (unsigned long)report.appTaskFree,
+        (unsigned long)report.discoveryTaskFree
+    );
+    return report;
+}
+
+bool SimpliSafe3::enableJournal() {
+    SS_LOG_LINE("Enabling event journal.");
+    SS3Lock stateGuard(stateLock);
+    if (journal) return true;
+
+    // default account's first location keeps the original file names
+    String prefix = SS_JOURNAL_PREFIX;
+    if (session->getAccount().length() != 0 || location != 0) prefix += "_" + session->getAccount() + location;
+    journal = new SS3EventJournal(prefix);
+    if (!journal->begin()) {
+        delete journal;
+        journal = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+bool SimpliSafe3::flushJournal() {
+    SS3Lock stateGuard(stateLock);
+    return journal ? journal->flush() : false;
+}
+
+size_t SimpliSafe3::queryJournal(uint32_t from, uint32_t to, int cid, SS3JournalCallback callback, void *context) {
+    SS3Lock stateGuard(stateLock);
+    if (!journal) {
+        SS_ERROR_LINE("Journal not enabled.");
+        return 0;
+    }
+
+    return journal->query(from, to, cid, callback, context);
+}
+
+bool SimpliSafe3::refreshSensors() {
+    int result;
+    if (runOnNetworkTask(SS_NET_COMMAND_REFRESH_SENSORS, 0, result)) return result;
+
+    SS_LOG_LINE("Refreshing sensors.");
+    SS3Lock stateGuard(stateLock);
+
+    if (subId.length() == 0) {
+        getSubscription();
+    }
+
+    StaticJsonDocument<128> filter;
+    filter["sensors"][0]["serial"] = true;
+    filter["sensors"][0]["type"] = true;
+    filter["sensors"][0]["name"] = true;
+    filter["sensors"][0]["status"]["triggered"] = true;
+
+    if (!SS3Memory::allows(SS_SENSOR_DOC_SIZE + SS_HEAP_REQUEST_COST, SS_SENSOR_DOC_SIZE, "sensor refresh")) return false;
+
+    DynamicJsonDocument data(SS_SENSOR_DOC_SIZE);
+    SS3Url url(SS3API "/ss3/subscriptions/%s/sensors?forceUpdate=false", subId.c_str());
+    int res = request(
+        url.c_str(),                           // url
+        data,                                  // size
+        true,                                  // auth
+        false,                                 // post
+        "",                                    // payload
+        nullptr,                               // headers
+        0,                                     // header count
+        &filter
+    );
+
+    if (res >= 200 && res <= 299 && data["sensors"].is<JsonArray>()) {
+        if (!sensors) sensors = new SS3SensorTable();
+        sensors->clear();
+
+        for (JsonObject item : data["sensors"].as<JsonArray>()) {
+            SS3Sensor *sensor = sensors->upsert(
+                SS3SensorTable::parseSerial(item["serial"]),
+                item["type"].as<int>(),
+                item["name"]
+            );
+            if (sensor && item["status"]["triggered"].is<bool>()) {
+                sensor->state = item["status"]["triggered"].as<bool>() ? SS_SENSOR_STATE_TRIGGERED : SS_SENSOR_STATE_CLEAR;
+            }
+        }
+
+        SS_LOG_LINE("Got %u sensors.", sensors->size());
+        return true;
+    }
+
+    SS_ERROR_LINE("Error getting sensors.");
+    return false;
+}
+
+bool SimpliSafe3::getSensor(uint32_t serial, SS3Sensor &sensor, char *name, size_t nameLength) {
+    SS3Lock stateGuard(stateLock);
+    if (!sensors) return false;
+
+    SS3Sensor *found = sensors->find(serial);
+    if (!found) return false;
+
+    sensors->settle(*found, time(nullptr));
+    sensor = *found;
+    if (name && nameLength > 0) strlcpy(name, sensors->getName(*found), nameLength);
+    return true;
+}
+
+bool SimpliSafe3::getSensor(const char *serial, SS3Sensor &sensor, char *name, size_t nameLength) {
+    return getSensor(SS3SensorTable::parseSerial(serial), sensor, name, nameLength);
+}
+
+void SimpliSafe3::setSensorEventCallback(void (*sensorEventCallback)(int eventId, const SS3Sensor &sensor, const char *name)) {
+    onSensorEvent = sensorEventCallback;
+}
+
+void SimpliSafe3::setLowMemoryCallback(void (*lowMemoryCallback)(size_t freeBytes, size_t largestBlock)) {
+    onLowMemory = lowMemoryCallback;
+}
+
+void SimpliSafe3::setHeapBudget(size_t reserveBytes) {
+    SS3Memory::setReserve(reserveBytes);
+}
+
+const SS3StartupMetrics &SimpliSafe3::getStartupMetrics() {
+    return startup;
+}
+
+bool SimpliSafe3::refreshAuthorization() {
+    int result;
+    if (runOnNetworkTask(SS_NET_COMMAND_REFRESH_AUTHORIZATION, 0, result)) return result;
+
+    SS_LOG_LINE("Refreshing authorization.");
+    SS3Lock stateGuard(stateLock);
+    if (SS3Trace::isRecording()) SS3Trace::recordOp(SS_TRACE_OP_AUTHORIZE);
+    return authManager->authorize(false, inSerial, inBaud);
+}
+
+SS3StateSnapshot SimpliSafe3::getStateSnapshot() {
+    return states.read();
+}
+
+bool SimpliSafe3::waitForStateChange(uint32_t sinceVersion, SS3StateSnapshot &snapshot, uint32_t timeoutMS) {
+    return states.waitForChange(sinceVersion, snapshot, timeoutMS);
+}
+
+bool SimpliSafe3::subscribeState(SS3StateCallback callback, void *context) {
+    return states.subscribe(callback, context);
+}
+
+void SimpliSafe3::unsubscribeState(SS3StateCallback callback, void *context) {
+    states.unsubscribe(callback, context);
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 #define __SIMPLISAFE3_H__
 
 #include "AuthManager.h"
+#include "EventJournal.h"
+#include "SensorTable.h"
+#include "Session.h"
+#include "StateStore.h"
+#include "common.h"
 #include <ArduinoJson.h>
-#include <WebSocketsClient.h>
 
 enum SS_GETSTATE {
     SS_GETSTATE_UNKNOWN = -1,
@@ -30,30 +34,146 @@ enum SS_SETLOCKSTATE {
     SS_SETLOCKSTATE_LOCK
 };
 
+enum SS_CALLBACK {
+    SS_CALLBACK_EVENT = 0,
+    SS_CALLBACK_CONNECT,
+    SS_CALLBACK_DISCONNECT,
+    SS_CALLBACK_LOW_MEMORY
+};
+
+struct SS3CallbackMessage {
+    uint8_t type;
+    int eventId;     // free heap for SS_CALLBACK_LOW_MEMORY
+    uint32_t serial; // sensor that raised the event, 0 for none, largest free block for SS_CALLBACK_LOW_MEMORY
+};
+
+enum SS_NET_COMMAND {
+    SS_NET_COMMAND_GET_ALARM_STATE = 0,
+    SS_NET_COMMAND_SET_ALARM_STATE,
+    SS_NET_COMMAND_GET_LOCK_STATE,
+    SS_NET_COMMAND_SET_LOCK_STATE,
+    SS_NET_COMMAND_REFRESH_SENSORS,
+    SS_NET_COMMAND_REFRESH_AUTHORIZATION
+};
+
+struct SS3NetCommand {
+    uint8_t type;
+    int arg;    // new state for the set commands
+    int result;
+};
+
+struct SS3StackReport {
+    uint32_t netTaskFree = 0; // bytes of stack never used, 0 when the task isn't running
+    uint32_t appTaskFree = 0; // same for the task calling loop()
+    uint32_t discoveryTaskFree = 0; // left by the last discovery task when it finished, 0 until one has
+};
+
+struct SS3StartupMetrics {
+    unsigned long authorizedMS = 0; // millis() when each stage finished, 0 until it does
+    unsigned long subscribedMS = 0;
+    unsigned long firstStateMS = 0;
+    bool reusedToken = false;       // persisted token was still valid, no refresh needed
+};
+
 class SimpliSafe3 {
+    friend class SS3Session;
+
     private:
         String subId;
         String userId;
         String lockId;
-        SS3AuthManager *authManager;
-        WebSocketsClient socket;
+        int location;
+        SS3Session *session;
+        SS3AuthManager *authManager; // the session's, shared with other locations on the account
         HardwareSerial *inSerial;
         unsigned long inBaud;
         unsigned long lastAuthCheck;
+        volatile int lastRequestResult = 0;
+        void (*onEvent)(int eventId) = nullptr;
+        void (*onConnect)() = nullptr;
+        void (*onDisconnect)() = nullptr;
+        void (*onSensorEvent)(int eventId, const SS3Sensor &sensor, const char *name) = nullptr;
+        void (*onLowMemory)(size_t freeBytes, size_t largestBlock) = nullptr;
+        unsigned long lowMemorySeen = 0;
+        TaskHandle_t netTask = nullptr;
+        TaskHandle_t appTask = nullptr;
+        int netCore = SS_NET_TASK_CORE;
+        volatile uint32_t discoveryStackFree = 0;
+        QueueHandle_t callbackQueue;            // callbacks for loop(), in both modes
+        QueueHandle_t stateQueue;               // changes for state subscribers, in both modes
+        QueueHandle_t commandQueue = nullptr;   // api calls handed to the network task
+        SemaphoreHandle_t commandDone = nullptr;
+        SemaphoreHandle_t commandLock;          // one handed-off call at a time
+        SemaphoreHandle_t stateLock;
+        volatile bool discovering = false;
+        SS3StartupMetrics startup;
+        SS3EventJournal *journal = nullptr;
+        SS3SensorTable *sensors = nullptr;
+        SS3StateStore states;
 
+        static void netTaskLoop(void *param);
+        static void discoveryTaskLoop(void *param);
+        bool startDiscovery();
+        void markFirstState();
+        void handleSubscribed();
+        void handleEvent(JsonObject data);
+        void poll();
+        bool runOnNetworkTask(int type, int arg, int &result);
+        void runCommand(SS3NetCommand &command);
+        void publishState(int alarmState, int lockState, uint16_t cid = 0);
+        int parseAlarmState(const JsonDocument &sub);
+        void dispatch(int type, int eventId = 0, uint32_t serial = 0);
+        void deliver(const SS3CallbackMessage &message);
+        void drainCallbacks();
+        void drainStates();
+        void deleteNetQueues();
+        int request(
+            const char *url,
+            JsonDocument &doc,
+            bool auth = true,
+            bool post = false,
+            const char *payload = "",
+            const SS3Header *headers = nullptr,
+            size_t headerCount = 0,
+            const JsonDocument *filter = nullptr,
+            const DeserializationOption::NestingLimit &nestingLimit = DeserializationOption::NestingLimit()
+        );
         String getUserID();
         StaticJsonDocument<256> getSubscription();
         StaticJsonDocument<192> getLock();
 
     public:
-        SimpliSafe3();
+        SimpliSafe3(const char *account = nullptr, int location = 0);
+        ~SimpliSafe3();
         bool setup(bool forceReauth = false, HardwareSerial *hwSerial = &Serial, unsigned long baud = 115200);
         void loop();
+        bool refreshAuthorization();
         int  getAlarmState();
         int  setAlarmState(int newState);
         int  getLockState();
         int  setLockState(int newState);
         bool startListeningToEvents(void (*eventCallback)(int eventId), void (*connectCallback)(), void (*disconnectCallback)());
+        const SS3BreakerMetrics &getBreakerMetrics(int endpoint = SS_ENDPOINT_API);
+        int  getLastRequestResult(); // HTTP status, SS_REQUEST_CIRCUIT_OPEN, SS_REQUEST_DEFERRED or -1
+        void handleFrame(uint8_t *payload, size_t length); // payload is parsed in place
+        void setFixtures(const SS3Fixture *fixtureList, size_t count);
+        bool startNetworkTask(int core = SS_NET_TASK_CORE);
+        void stopNetworkTask();
+        SS3StackReport getStackHighWaterMarks();
+        bool enableJournal();
+        bool flushJournal();
+        size_t queryJournal(uint32_t from, uint32_t to, int cid, SS3JournalCallback callback, void *context = nullptr);
+        bool refreshSensors();
+        bool getSensor(uint32_t serial, SS3Sensor &sensor, char *name = nullptr, size_t nameLength = 0);
+        bool getSensor(const char *serial, SS3Sensor &sensor, char *name = nullptr, size_t nameLength = 0);
+        const SS3StartupMetrics &getStartupMetrics();
+        void setSensorEventCallback(void (*sensorEventCallback)(int eventId, const SS3Sensor &sensor, const char *name));
+        void setLowMemoryCallback(void (*lowMemoryCallback)(size_t freeBytes, size_t largestBlock));
+        void setHeapBudget(size_t reserveBytes); // one budget for every instance, they share the heap
+        SS3StateSnapshot getStateSnapshot();
+        bool waitForStateChange(uint32_t sinceVersion, SS3StateSnapshot &snapshot, uint32_t timeoutMS = SS_STATE_WAIT_FOREVER);
+        bool subscribeState(SS3StateCallback callback, void *context = nullptr);
+        void unsubscribeState(SS3StateCallback callback, void *context = nullptr);
 };
 
 #endif
\ No newline at end of file
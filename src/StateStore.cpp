@@ -0,0 +1,161 @@
+#include "StateStore.h"
+
+//
+// Private Member Functions
+//
+
+int SS3StateStore::claimWaiterBit() {
+    xSemaphoreTake(listLock, portMAX_DELAY);
+    int bit = -1;
+    for (int x = 0; x < SS_STATE_MAX_WAITERS && bit < 0; x++) {
+        if (!(waiterBits & (1UL << x))) bit = x;
+    }
+
+    if (bit >= 0) {
+        waiterBits |= 1UL << bit;
+        xEventGroupClearBits(changed, 1UL << bit); // stale from the last waiter on this bit
+    }
+    xSemaphoreGive(listLock);
+    return bit;
+}
+
+void SS3StateStore::releaseWaiterBit(int bit) {
+    xSemaphoreTake(listLock, portMAX_DELAY);
+    waiterBits &= ~(1UL << bit);
+    xSemaphoreGive(listLock);
+}
+
+//
+// Public Member Functions
+//
+
+SS3StateStore::SS3StateStore() {
+    writeLock = xSemaphoreCreateMutex();
+    listLock = xSemaphoreCreateMutex();
+    changed = xEventGroupCreate();
+}
+
+SS3StateStore::~SS3StateStore() {
+    vSemaphoreDelete(writeLock);
+    vSemaphoreDelete(listLock);
+    vEventGroupDelete(changed);
+}
+
+SS3StateSnapshot SS3StateStore::read() {
+    SS3StateSnapshot copy;
+    for (;;) {
+        uint32_t before = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            // a lower priority writer may be mid-write on this core, sleep so it can finish
+            vTaskDelay(1);
+            continue;
+        }
+
+        copy = snapshot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&sequence, __ATOMIC_RELAXED) == before) return copy;
+    }
+}
+
+bool SS3StateStore::publish(int alarmState, int lockState, uint16_t cid, SS3StateSnapshot &previous, SS3StateSnapshot &current) {
+    xSemaphoreTake(writeLock, portMAX_DELAY);
+    previous = snapshot;
+    current = snapshot;
+    if (alarmState != SS_STATE_KEEP) current.alarmState = alarmState;
+    if (lockState != SS_STATE_KEEP) current.lockState = lockState;
+
+    if (current.alarmState == previous.alarmState && current.lockState == previous.lockState) {
+        xSemaphoreGive(writeLock);
+        return false; // readers only hear about real changes
+    }
+
+    current.version = previous.version + 1;
+    current.cid = cid;
+    current.updatedMS = millis();
+
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    snapshot = current;
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+    xSemaphoreGive(writeLock);
+
+    SS_LOG_LINE("State %lu: alarm %i, lock %i.", (unsigned long)current.version, current.alarmState, current.lockState);
+    xEventGroupSetBits(changed, (1UL << SS_STATE_MAX_WAITERS) - 1); // unclaimed bits are cleared when claimed
+    return true;
+}
+
+bool SS3StateStore::waitForChange(uint32_t sinceVersion, SS3StateSnapshot &current, uint32_t timeoutMS) {
+    current = read();
+    if (current.version != sinceVersion) return true;
+
+    int bit = claimWaiterBit();
+    if (bit < 0) {
+        SS_ERROR_LINE("More than %i tasks waiting for state.", SS_STATE_MAX_WAITERS);
+        return false;
+    }
+
+    const unsigned long start = millis();
+    bool changedVersion = false;
+    for (;;) {
+        current = read();
+        if (current.version != sinceVersion) {
+            changedVersion = true;
+            break;
+        }
+
+        unsigned long elapsed = millis() - start;
+        if (timeoutMS != SS_STATE_WAIT_FOREVER && elapsed >= timeoutMS) break;
+
+        TickType_t ticks = timeoutMS == SS_STATE_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMS - elapsed);
+        xEventGroupWaitBits(changed, 1UL << bit, pdTRUE, pdTRUE, ticks);
+    }
+
+    releaseWaiterBit(bit);
+    return changedVersion;
+}
+
+bool SS3StateStore::subscribe(SS3StateCallback callback, void *context) {
+    xSemaphoreTake(listLock, portMAX_DELAY);
+    for (int x = 0; x < SS_STATE_MAX_SUBSCRIBERS; x++) {
+        if (!callbacks[x]) {
+            callbacks[x] = callback;
+            contexts[x] = context;
+            xSemaphoreGive(listLock);
+            return true;
+        }
+    }
+    xSemaphoreGive(listLock);
+
+    SS_ERROR_LINE("Already %i state subscribers.", SS_STATE_MAX_SUBSCRIBERS);
+    return false;
+}
+
+void SS3StateStore::unsubscribe(SS3StateCallback callback, void *context) {
+    xSemaphoreTake(listLock, portMAX_DELAY);
+    for (int x = 0; x < SS_STATE_MAX_SUBSCRIBERS; x++) {
+        if (callbacks[x] == callback && contexts[x] == context) callbacks[x] = nullptr;
+    }
+    xSemaphoreGive(listLock);
+}
+
+bool SS3StateStore::hasSubscribers() {
+    bool any = false;
+    xSemaphoreTake(listLock, portMAX_DELAY);
+    for (int x = 0; x < SS_STATE_MAX_SUBSCRIBERS && !any; x++) any = callbacks[x] != nullptr;
+    xSemaphoreGive(listLock);
+    return any;
+}
+
+void SS3StateStore::notify(const SS3StateSnapshot &previous, const SS3StateSnapshot &current) {
+    // copied out so a callback can unsubscribe itself
+    SS3StateCallback toCall[SS_STATE_MAX_SUBSCRIBERS];
+    void *toPass[SS_STATE_MAX_SUBSCRIBERS];
+    xSemaphoreTake(listLock, portMAX_DELAY);
+    memcpy(toCall, callbacks, sizeof(toCall));
+    memcpy(toPass, contexts, sizeof(toPass));
+    xSemaphoreGive(listLock);
+
+    for (int x = 0; x < SS_STATE_MAX_SUBSCRIBERS; x++) {
+        if (toCall[x]) toCall[x](previous, current, toPass[x]);
+    }
+}
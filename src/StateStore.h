@@ -0,0 +1,55 @@
+#ifndef __SS3STATESTORE_H__
+#define __SS3STATESTORE_H__
+
+#include <Arduino.h>
+#include "common.h"
+
+#define SS_STATE_KEEP -2 // publish() leaves this field as it was
+#define SS_STATE_WAIT_FOREVER 0xFFFFFFFF
+
+struct SS3StateSnapshot {
+    uint32_t version = 0;     // bumps on every change, 0 until something is known
+    int8_t alarmState = -1;   // SS_GETSTATE, -1 unknown
+    int8_t lockState = -1;    // SS_GETLOCKSTATE, -1 unknown
+    uint16_t cid = 0;         // event that caused the change, 0 for an API response
+    unsigned long updatedMS = 0;
+};
+
+struct SS3StateChange {
+    SS3StateSnapshot oldState;
+    SS3StateSnapshot newState;
+};
+
+typedef void (*SS3StateCallback)(const SS3StateSnapshot &oldState, const SS3StateSnapshot &newState, void *context);
+
+// Latest alarm and lock state for any number of local readers. Reads are a
+// seqlock copy with no lock taken, so polling it costs nothing on the network.
+// Waiters each get their own event group bit, so a change can't slip between
+// checking the version and starting to wait.
+class SS3StateStore {
+    private:
+        SS3StateSnapshot snapshot;
+        uint32_t sequence = 0; // odd while a write is in progress
+        SemaphoreHandle_t writeLock;
+        SemaphoreHandle_t listLock; // waiter bits and subscribers
+        EventGroupHandle_t changed;
+        uint32_t waiterBits = 0;
+        SS3StateCallback callbacks[SS_STATE_MAX_SUBSCRIBERS] = {};
+        void *contexts[SS_STATE_MAX_SUBSCRIBERS] = {};
+
+        int claimWaiterBit();
+        void releaseWaiterBit(int bit);
+
+    public:
+        SS3StateStore();
+        ~SS3StateStore();
+        SS3StateSnapshot read();
+        bool publish(int alarmState, int lockState, uint16_t cid, SS3StateSnapshot &previous, SS3StateSnapshot &current);
+        bool waitForChange(uint32_t sinceVersion, SS3StateSnapshot &current, uint32_t timeoutMS = SS_STATE_WAIT_FOREVER);
+        bool subscribe(SS3StateCallback callback, void *context = nullptr);
+        void unsubscribe(SS3StateCallback callback, void *context = nullptr);
+        bool hasSubscribers();
+        void notify(const SS3StateSnapshot &previous, const SS3StateSnapshot &current);
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include "Trace.h"
+#include "common.h"
+#include "SimpliSafe3.h"
+#include <SPIFFS.h>
+
+const char* SS_TRACE_REDACT_KEYS[6] = {
+    "access_token",
+    "refresh_token",
+    "id_token",
+    "token",
+    "code",
+    "code_verifier"
+};
+
+String SS3Trace::path;
+unsigned long SS3Trace::lastRecordMS = 0;
+
+//
+// SS3Trace Private Member Functions
+//
+
+void SS3Trace::write(uint8_t type, int16_t code, int16_t arg, const char *url, const uint8_t *body, size_t bodyLength) {
+    if (path.length() == 0) return;
+
+    const unsigned long now = millis();
+    SS3TraceHeader header;
+    header.type = type;
+    header.deltaMS = now - lastRecordMS;
+    header.code = code;
+    header.arg = arg;
+    header.urlLength = url ? strlen(url) : 0;
+    header.bodyLength = bodyLength;
+    lastRecordMS = now;
+
+    // mounted by begin(), closed after each record so a reset keeps everything before it
+    File file = SPIFFS.open(path, "a");
+    if (!file) {
+        SS_ERROR_LINE("Failed to open %s.", path.c_str());
+        return;
+    }
+
+    file.write((const uint8_t *)&header, sizeof(header));
+    if (header.urlLength) file.write((const uint8_t *)url, header.urlLength);
+    if (bodyLength) file.write(body, bodyLength);
+    file.close();
+}
+
+//
+// SS3Trace Public Member Functions
+//
+
+bool SS3Trace::begin(const char *tracePath) {
+    SS_LOG_LINE("Capturing trace to %s.", tracePath);
+    if (!SPIFFS.begin(true)) {
+        SS_ERROR_LINE("Error starting SPIFFS.");
+        return false;
+    }
+
+    File file = SPIFFS.open(tracePath, "w");
+    if (!file) {
+        SS_ERROR_LINE("Failed to open %s.", tracePath);
+        return false;
+    }
+
+    file.write((const uint8_t *)SS_TRACE_MAGIC, strlen(SS_TRACE_MAGIC));
+    file.close();
+
+    path = tracePath;
+    lastRecordMS = millis();
+    return true;
+}
+
+void SS3Trace::end() {
+    SS_LOG_LINE("Stopped capturing trace.");
+    path = "";
+}
+
+bool SS3Trace::isRecording() {
+    return path.length() != 0;
+}
+
+void SS3Trace::redact(String &json) {
+    for (int k = 0; k < sizeof(SS_TRACE_REDACT_KEYS) / sizeof(SS_TRACE_REDACT_KEYS[0]); k++) {
+        String key = String("\"") + SS_TRACE_REDACT_KEYS[k] + "\"";
+        int at = json.indexOf(key);
+        while (at >= 0) {
+            // find the string value after "key" : "
+            unsigned int x = at + key.length();
+            while (x < json.length() && isspace(json[x])) x++;
+            if (x < json.length() && json[x] == ':') {
+                x++;
+                while (x < json.length() && isspace(json[x])) x++;
+            }
+
+            if (x < json.length() && json[x] == '"') {
+                unsigned int start = ++x;
+                while (x < json.length() && json[x] != '"') x += json[x] == '\\' ? 2 : 1;
+                json = json.substring(0, start) + SS_TRACE_REDACTED + json.substring(min(x, json.length()));
+                x = start + strlen(SS_TRACE_REDACTED);
+            }
+
+            at = json.indexOf(key, x);
+        }
+    }
+}
+
+void SS3Trace::recordOp(int op, int arg) {
+    write(SS_TRACE_OP, op, arg, nullptr, nullptr, 0);
+}
+
+void SS3Trace::recordRequest(const char *url, bool post, const char *payload) {
+    String body = payload;
+    redact(body);
+    write(SS_TRACE_REQUEST, post ? 1 : 0, 0, url, (const uint8_t *)body.c_str(), body.length());
+}
+
+void SS3Trace::recordResponse(int status, const String &body) {
+    String sanitized = body;
+    redact(sanitized);
+    write(SS_TRACE_RESPONSE, status, 0, nullptr, (const uint8_t *)sanitized.c_str(), sanitized.length());
+}
+
+void SS3Trace::recordFrame(const uint8_t *payload, size_t length) {
+    String body;
+    body.concat((const char *)payload, length);
+    redact(body);
+    write(SS_TRACE_FRAME, 0, 0, nullptr, (const uint8_t *)body.c_str(), body.length());
+}
+
+//
+// SS3TraceReplayer Private Member Functions
+//
+
+bool SS3TraceReplayer::next(SS3TraceHeader &header) {
+    if (hasPending) {
+        header = pending;
+        hasPending = false;
+        return true;
+    }
+
+    if (file.read((uint8_t *)&header, sizeof(header)) != sizeof(header)) return false;
+    traceMS += header.deltaMS;
+    return true;
+}
+
+bool SS3TraceReplayer::readString(String &out, size_t length) {
+    out = "";
+    if (length == 0) return true;
+    if (!out.reserve(length)) {
+        SS_ERROR_LINE("Not enough memory to replay a %u byte record.", length);
+        file.seek(length, SeekCur);
+        return false;
+    }
+
+    char chunk[128];
+    while (length > 0) {
+        size_t n = file.read((uint8_t *)chunk, min(length, sizeof(chunk)));
+        if (n == 0) return false;
+        out.concat(chunk, n);
+        length -= n;
+    }
+
+    return true;
+}
+
+size_t SS3TraceReplayer::loadResponses() {
+    // pair up the requests that followed an op into fixtures it can consume
+    size_t count = 0;
+    SS3TraceHeader header;
+    while (next(header)) {
+        if (header.type != SS_TRACE_REQUEST) {
+            pending = header;
+            hasPending = true;
+            break;
+        }
+
+        String url;
+        readString(url, header.urlLength);
+        file.seek(header.bodyLength, SeekCur); // payload only matters to the server
+        bool post = header.code == 1;
+
+        if (!next(header) || header.type != SS_TRACE_RESPONSE) {
+            SS_ERROR_LINE("Trace request without a response.");
+            if (header.type != SS_TRACE_RESPONSE) {
+                pending = header;
+                hasPending = true;
+            }
+            break;
+        }
+
+        if (count >= SS_TRACE_MAX_OP_REQUESTS) {
+            file.seek(header.urlLength + header.bodyLength, SeekCur);
+            continue;
+        }
+
+        file.seek(header.urlLength, SeekCur);
+        urls[count] = url.substring(url.indexOf("/", 8)); // drop scheme and host
+        readString(bodies[count], header.bodyLength);
+        fixtures[count].post = post;
+        fixtures[count].path = urls[count].c_str();
+        fixtures[count].status = header.code;
+        fixtures[count].body = bodies[count].c_str();
+        count++;
+    }
+
+    return count;
+}
+
+void SS3TraceReplayer::runOp(SimpliSafe3 &ss, int op, int arg) {
+    switch (op) {
+        case SS_TRACE_OP_AUTHORIZE: ss.refreshAuthorization(); break;
+        case SS_TRACE_OP_GET_ALARM_STATE: ss.getAlarmState(); break;
+        case SS_TRACE_OP_SET_ALARM_STATE: ss.setAlarmState(arg); break;
+        case SS_TRACE_OP_GET_LOCK_STATE: ss.getLockState(); break;
+        case SS_TRACE_OP_SET_LOCK_STATE: ss.setLockState(arg); break;
+        default: SS_ERROR_LINE("Unknown trace op %i.", op);
+    }
+}
+
+//
+// SS3TraceReplayer Public Member Functions
+//
+
+SS3ReplayStats SS3TraceReplayer::run(SimpliSafe3 &ss, const char *tracePath, bool realTime) {
+    SS_LOG_LINE("Replaying %s.", tracePath);
+    SS3ReplayStats stats;
+
+    if (!SPIFFS.begin(true)) {
+        SS_ERROR_LINE("Error starting SPIFFS.");
+        return stats;
+    }
+
+    file = SPIFFS.open(tracePath, "r");
+    if (!file) {
+        SS_ERROR_LINE("Failed to open %s.", tracePath);
+        return stats;
+    }
+
+    char magic[4];
+    if (file.read((uint8_t *)magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, SS_TRACE_MAGIC, sizeof(magic)) != 0) {
+        SS_ERROR_LINE("%s is not a trace file.", tracePath);
+        file.close();
+        return stats;
+    }
+
+    hasPending = false;
+    traceMS = 0;
+    const unsigned long startMS = millis();
+    SS3TraceHeader header;
+    String frame;
+
+    while (next(header)) {
+        stats.records++;
+        if (realTime) {
+            while (millis() - startMS < traceMS) delay(1);
+        }
+
+        if (header.type == SS_TRACE_OP) {
+            size_t count = loadResponses();
+            stats.records += count * 2;
+            stats.responses += count;
+            stats.ops++;
+
+            ss.setFixtures(fixtures, count);
+            runOp(ss, header.code, header.arg);
+            ss.setFixtures(nullptr, 0);
+        } else if (header.type == SS_TRACE_FRAME) {
+            file.seek(header.urlLength, SeekCur);
+            if (!readString(frame, header.bodyLength)) continue;
+
+            unsigned long frameStart = micros();
+            ss.handleFrame((uint8_t *)&frame[0], frame.length());
+            stats.maxFrameUS = max(stats.maxFrameUS, micros() - frameStart);
+            stats.frames++;
+        } else {
+            // requests made outside a recorded op, nothing to drive them
+            file.seek(header.urlLength + header.bodyLength, SeekCur);
+        }
+    }
+
+    file.close();
+    stats.elapsedMS = millis() - startMS;
+    SS_LOG_LINE("Replayed %lu records in %lums.", stats.records, stats.elapsedMS);
+    return stats;
+}
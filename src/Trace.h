@@ -0,0 +1,85 @@
+#ifndef __SS3TRACE_H__
+#define __SS3TRACE_H__
+
+#include <Arduino.h>
+#include <FS.h>
+#include "Fixture.h"
+
+#define SS_TRACE_MAGIC "SST1"
+#define SS_TRACE_MAX_OP_REQUESTS 8 // responses one operation can consume during replay
+#define SS_TRACE_REDACTED "REDACTED"
+
+enum SS_TRACE_RECORD {
+    SS_TRACE_OP = 1,  // a public SimpliSafe3 call, code is the op and arg its argument
+    SS_TRACE_REQUEST, // code is 1 for POST, body is the payload
+    SS_TRACE_RESPONSE, // code is the HTTP status
+    SS_TRACE_FRAME    // an incoming WebSocket text frame
+};
+enum SS_TRACE_OPS {
+    SS_TRACE_OP_AUTHORIZE = 0,
+    SS_TRACE_OP_GET_ALARM_STATE,
+    SS_TRACE_OP_SET_ALARM_STATE,
+    SS_TRACE_OP_GET_LOCK_STATE,
+    SS_TRACE_OP_SET_LOCK_STATE
+};
+
+struct __attribute__((packed)) SS3TraceHeader {
+    uint8_t type;
+    uint32_t deltaMS; // since the previous record
+    int16_t code;
+    int16_t arg;
+    uint16_t urlLength;
+    uint32_t bodyLength;
+};
+
+struct SS3ReplayStats {
+    unsigned long records = 0;
+    unsigned long ops = 0;
+    unsigned long frames = 0;
+    unsigned long responses = 0;
+    unsigned long elapsedMS = 0;
+    unsigned long maxFrameUS = 0;
+};
+
+class SimpliSafe3;
+
+// Writes sanitized requests, responses and frames to a trace file on SPIFFS.
+class SS3Trace {
+    private:
+        static String path;
+        static unsigned long lastRecordMS;
+
+        static void write(uint8_t type, int16_t code, int16_t arg, const char *url, const uint8_t *body, size_t bodyLength);
+
+    public:
+        static bool begin(const char *tracePath);
+        static void end();
+        static bool isRecording();
+        static void redact(String &json);
+        static void recordOp(int op, int arg = 0);
+        static void recordRequest(const char *url, bool post, const char *payload);
+        static void recordResponse(int status, const String &body);
+        static void recordFrame(const uint8_t *payload, size_t length);
+};
+
+// Feeds a trace back through a SimpliSafe3, either at recorded speed or as fast as possible.
+class SS3TraceReplayer {
+    private:
+        File file;
+        SS3TraceHeader pending;
+        bool hasPending = false;
+        unsigned long traceMS = 0; // trace time of the last record read
+        String urls[SS_TRACE_MAX_OP_REQUESTS];
+        String bodies[SS_TRACE_MAX_OP_REQUESTS];
+        SS3Fixture fixtures[SS_TRACE_MAX_OP_REQUESTS];
+
+        bool next(SS3TraceHeader &header);
+        bool readString(String &out, size_t length);
+        size_t loadResponses();
+        void runOp(SimpliSafe3 &ss, int op, int arg);
+
+    public:
+        SS3ReplayStats run(SimpliSafe3 &ss, const char *tracePath, bool realTime = false);
+};
+
+#endif
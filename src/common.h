@@ -1,6 +1,10 @@
 #ifndef __SSCOMMON_H__
 #define __SSCOMMON_H__
 
+#include <esp_heap_caps.h>
+
+#define SS_VERSION "0.0.1"
+
 // API constants
 #define SS3API "https://api.simplisafe.com/v1"
 #define SS_OAUTH "https://auth.simplisafe.com/oauth"
@@ -8,11 +12,13 @@
 #define SS_OAUTH_CLIENT_ID "42aBZ5lYrVW12jfOuu3CQROitwxg9sN5"
 #define SS_OAUTH_AUTH_URL "https://auth.simplisafe.com/authorize"
 #define SS_OAUTH_REDIRECT_URI "com.simplisafe.mobile://auth.simplisafe.com/ios/com.simplisafe.mobile/callback"
+#define SS_OAUTH_REDIRECT_URI_ENCODED "com.simplisafe.mobile%3A%2F%2Fauth.simplisafe.com%2Fios%2Fcom.simplisafe.mobile%2Fcallback"
 #define SS_OAUTH_SCOPE "offline_access%20email%20openid%20https://api.simplisafe.com/scopes/user:platform"
 #define SS_OAUTH_AUDIENCE "https://api.simplisafe.com/"
 #define SS_WEBSOCKET_URL "socketlink.prd.aser.simplisafe.com"
 
-#define SS_USER_DATA_FILE "/SS_USER_DATA.json"
+#define SS_USER_DATA_FILE "/SS_USER_DATA.json" // default account
+#define SS_USER_DATA_PREFIX "/ss_" // named accounts, "/ss_<account>.json"
 
 #define SS_TIME_GMT_OFFSET -8 * 3600 // - 8 hours PST
 #define SS_DST_OFFSET 1 * 3600
@@ -20,6 +26,78 @@
 
 #define SS_AUTH_REFRESH_BUFFER 300000 // 5 minutes
 #define SS_AUTH_CHECK_INTERVAL 60000 // one minute
+#define SS_CLOCK_SYNC_WAIT 2000 // ms to wait for NTP before deciding the persisted token can't be checked
+#define SS_MIN_VALID_TIME 1600000000 // anything earlier means the clock hasn't synced
+
+// Network task, opt-in with SimpliSafe3::startNetworkTask()
+#define SS_NET_TASK_CORE 0 // protocol core, Arduino's loop() runs on core 1
+#define SS_NET_TASK_STACK 8192
+#define SS_NET_TASK_PRIORITY 1
+#define SS_NET_TASK_INTERVAL 10 // ms between polls
+#define SS_CALLBACK_QUEUE_LENGTH 16
+#define SS_DISCOVERY_TASK_STACK 8192 // one-shot task fetching user and subscription at startup
+
+// Request building, fixed buffers so API calls don't fragment the heap
+#define SS_URL_MAX 192
+#define SS_AUTH_URL_MAX 640 // authorization URL printed for the user
+#define SS_TOKEN_PAYLOAD_MAX 512 // token request body, refresh tokens are well under this
+
+// Sessions, one per account shared by every SimpliSafe3 on it
+#define SS_MAX_ACCOUNTS 4
+#define SS_MAX_LOCATIONS 4 // SimpliSafe3 instances per account
+#define SS_ACCOUNT_NAME_MAX 16 // keeps namespaced SPIFFS paths under 32 characters
+
+// Connection pool, one keep-alive TLS connection per endpoint for all sessions
+#define SS_POOL_KEEP_ALIVE 1 // 0 to close after every request
+#define SS_POOL_IDLE_TIMEOUT 50000 // ms, reconnect rather than reuse a connection the server may have dropped
+
+// Heap budget, expensive operations are deferred rather than started without room to finish
+#define SS_HEAP_RESERVE 0 // bytes left free for the rest of the app, SimpliSafe3::setHeapBudget() changes it
+#define SS_HEAP_TLS_COST 45000 // peak of a TLS handshake plus the request
+#define SS_HEAP_TLS_BLOCK 17000 // mbedTLS's 16 KB record buffer must be contiguous
+#define SS_HEAP_REQUEST_COST 6144 // request over an already open connection
+#define SS_PARSE_TOKEN_SIZE 3072 // pooled documents, allocated once at startup
+#define SS_PARSE_FRAME_SIZE 2048
+#define SS_PARSE_IDENTIFY_SIZE 2048
+
+// Heap drift limits for SS3HeapMonitor, compared against the baseline taken after warm-up
+#define SS_HEAP_DRIFT_LARGEST_BLOCK 4096 // bytes the largest free block may shrink
+#define SS_HEAP_DRIFT_ALLOCATIONS 32 // extra live allocations
+#define SS_HEAP_DRIFT_MINIMUM_FREE 4096 // bytes the free heap low-water mark may fall
+
+// WebSocket frame limits are SS_FRAME_MAX_LENGTH and SS_FRAME_NESTING_LIMIT in FrameParser.h,
+// kept there so the parser builds without this file
+
+// Local state snapshot shared by in-process readers
+#define SS_STATE_MAX_SUBSCRIBERS 8
+#define SS_STATE_MAX_WAITERS 8 // tasks blocked in waitForStateChange() at once, max 24
+#define SS_STATE_QUEUE_LENGTH 4 // changes held for subscribers until the next loop()
+
+// Event journal, opt-in with SimpliSafe3::enableJournal()
+#ifndef SS_JOURNAL_LITTLEFS
+    #define SS_JOURNAL_LITTLEFS 0 // 1 to keep the journal on LittleFS instead of SPIFFS
+#endif
+#define SS_JOURNAL_PREFIX "/ssj"
+#define SS_JOURNAL_SEGMENTS 4
+#define SS_JOURNAL_SEGMENT_RECORDS 256 // 5 KB per segment
+#define SS_JOURNAL_BATCH 8 // records held in RAM before a write
+#define SS_JOURNAL_FLUSH_INTERVAL 30000 // 30 seconds
+
+// Sensor inventory
+#define SS_MAX_SENSORS 48
+#define SS_SENSOR_NAME_POOL 768 // bytes shared by all sensor names
+#define SS_SENSOR_DOC_SIZE 8192 // filtered sensors response, about 120 bytes per sensor
+#define SS_SENSOR_TRIGGER_HOLD 60 // seconds a sensor reads triggered after its last trigger event
+
+// Circuit breaker
+#define SS_BREAKER_FAILURE_THRESHOLD 3 // consecutive 5xx/transport failures before opening
+#define SS_BREAKER_BASE_BACKOFF 5000 // 5 seconds
+#define SS_BREAKER_MAX_BACKOFF 300000 // 5 minutes
+#define SS_BREAKER_MAX_RETRY_AFTER 3600000 // one hour
+
+// Request result codes, kept clear of HTTPClient's -1 to -11
+#define SS_REQUEST_CIRCUIT_OPEN -100
+#define SS_REQUEST_DEFERRED -101 // not enough heap, try again later
 
 // get this from login page
 #define SS_OAUTH_CA_CERT \
@@ -87,20 +165,28 @@ rqXRfboQnoZsG4q5WTP468SQvvG5\n\
 
 #define SS_DEBUG SS_DEBUG_LEVEL_ERROR
 
+// Profiling, set to 1 to collect per-call timing and heap stats (see Profiler.h)
+#ifndef SS_PROFILE
+    #define SS_PROFILE 0
+#endif
+
+// log lines show free heap and the largest free block, a shrinking block with steady free heap is fragmentation
+#define SS_LARGEST_BLOCK_KB (heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) * 0.001f)
+
 #if SS_DEBUG >= SS_DEBUG_LEVEL_ERROR
-    #define SS_ERROR_LINE(message, ...) printf("ERR [%7lu][%.2fkb] SimpliSafe: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), ##__VA_ARGS__)
+    #define SS_ERROR_LINE(message, ...) printf("ERR [%7lu][%.2fkb/%.2fkb] SimpliSafe: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), SS_LARGEST_BLOCK_KB, ##__VA_ARGS__)
 #else
     #define SS_ERROR_LINE(message, ...)
 #endif
 
 #if SS_DEBUG >= SS_DEBUG_LEVEL_INFO
-    #define SS_LOG_LINE(message, ...) printf(">>> [%7lu][%.2fkb] SimpliSafe: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), ##__VA_ARGS__)
+    #define SS_LOG_LINE(message, ...) printf(">>> [%7lu][%.2fkb/%.2fkb] SimpliSafe: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), SS_LARGEST_BLOCK_KB, ##__VA_ARGS__)
 #else
     #define SS_LOG_LINE(message, ...)
 #endif
 
 #if SS_DEBUG >= SS_DEBUG_LEVEL_ALL
-    #define SS_DETAIL_LINE(message, ...) printf(">>> [%7lu][%.2fkb] SimpliSafe: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), ##__VA_ARGS__)
+    #define SS_DETAIL_LINE(message, ...) printf(">>> [%7lu][%.2fkb/%.2fkb] SimpliSafe: " message "\n", millis(), (esp_get_free_heap_size() * 0.001f), SS_LARGEST_BLOCK_KB, ##__VA_ARGS__)
 #else
     #define SS_DETAIL_LINE(message, ...)
 #endif